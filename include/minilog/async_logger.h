@@ -1,5 +1,13 @@
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <span>
+#include <vector>
+
 #include <minilog/logger.h>
 #include <minilog/registry.h>
 #include <minilog/thread_pool.h>
@@ -8,62 +16,152 @@ namespace minilog {
 
 static const size_t default_async_q_size = 8192;
 
+namespace details {
+// the part of an async_logger the pool workers use. queue records point at it without
+// owning it and it counts the ones released. a logger destroyed with records still queued
+// leaves it to the pool, which frees it after the last of them
+class async_backend {
+public:
+    explicit async_backend(std::vector<sink_ptr> sinks) : sinks_(std::move(sinks)) {}
+
+    void sink_batch(std::span<const log_msg> msgs) {
+        for (auto &sink : sinks_) {
+            sink->log_batch(msgs);
+        }
+    }
+
+    void flush() {
+        for (auto &sink : sinks_) {
+            sink->flush();
+        }
+    }
 
+    // called by the worker (or whoever drops the record) once the record is finished with.
+    // seq_cst, pairs with the retired and parked flush flags of the pool
+    void record_done(async_msg_type msg_type) noexcept {
+        if (msg_type == async_msg_type::flush) {
+            released_flushes_.fetch_add(1, std::memory_order_seq_cst);
+        } else {
+            released_logs_.fetch_add(1, std::memory_order_seq_cst);
+        }
+    }
 
-class async_logger final : public std::enable_shared_from_this<async_logger>,
-                           public logger {
-    friend class thread_pool;
+    // never more than the records released so far, both counts only grow
+    size_t released() const noexcept {
+        return released_logs_.load(std::memory_order_seq_cst) + released_flushes_.load(std::memory_order_seq_cst);
+    }
+
+    size_t logs_released() const noexcept {
+        return released_logs_.load(std::memory_order_seq_cst);
+    }
+
+private:
+    std::vector<sink_ptr> sinks_;
+    alignas(cache_line_size) std::atomic<size_t> released_logs_{0};
+    std::atomic<size_t> released_flushes_{0};
+};
+}
+
+// queue records point at the logger's backend without owning it. the logger counts the
+// records it posted, its destructor hands the backend to the pool and returns at once,
+// the worker writes what is still queued and frees the backend and its sinks after the
+// last record. that holds when the last reference goes away on a pool worker too.
+// it owns a reference to its thread pool, so posting never has to lock a weak_ptr: the
+// pool lives until its last logger is gone, even after init_thread_pool replaced it in
+// the registry. logging can no longer fail with "thread pool doesn't exist anymore".
+// keep another reference to the pool (the registry's) when a logger may be dropped on
+// one of its workers, a pool can't join the thread it is destroyed on
+class async_logger final : public logger {
 public:
     template <typename It>
     async_logger(std::string logger_name, It begin, It end,
-                 std::weak_ptr<thread_pool> tp,
+                 std::shared_ptr<thread_pool> tp,
                  async_overflow_policy overflow_policy = async_overflow_policy::block)
         : logger(std::move(logger_name), begin, end),
           thread_pool_(std::move(tp)),
-          overflow_policy_(overflow_policy) {}
+          overflow_policy_(overflow_policy),
+          backend_(std::make_unique<details::async_backend>(sinks_)) {
+        if (thread_pool_ == nullptr) {
+            throw std::runtime_error("async log: thread pool doesn't exist anymore");
+        }
+    }
 
     async_logger(std::string logger_name,
                  std::initializer_list<std::shared_ptr<sinks::sink>> sinks_list,
-                 std::weak_ptr<thread_pool> tp,
+                 std::shared_ptr<thread_pool> tp,
                  async_overflow_policy overflow_policy = async_overflow_policy::block)
         : async_logger(std::move(logger_name), sinks_list.begin(), sinks_list.end(),
                        std::move(tp), overflow_policy) {}
     async_logger(std::string logger_name,
                  std::shared_ptr<sinks::sink> single_sink,
-                 std::weak_ptr<thread_pool> tp,
+                 std::shared_ptr<thread_pool> tp,
                  async_overflow_policy overflow_policy = async_overflow_policy::block)
         : async_logger(std::move(logger_name), {std::move(single_sink)}, std::move(tp), overflow_policy) {}           
     // std::shared_ptr<logger> clone(std::string new_name) override;
-    ~async_logger() = default;
+    ~async_logger() override {
+        // every producer has let go of the logger by now, so the posted counts are final
+        size_t posted = logs_posted_() + posted_flushes_.load(std::memory_order_relaxed);
+        thread_pool_->retire_backend_(std::move(backend_), posted);
+    }
+
+    // copy the arguments into the queue record and run std::vformat on the worker thread,
+    // calls with arguments that aren't deferrable_arg are still formatted by the caller
+    void set_deferred_formatting(bool enabled) {
+        deferred_formatting_.store(enabled, std::memory_order_relaxed);
+    }
+
+    // queues a flush behind the records posted so far and returns without touching a sink.
+    // the future is ready once those records are written, by whichever pool threads hold
+    // them, and every sink is flushed. get() rethrows what a sink flush threw, or
+    // broken_promise when the overflow policy dropped the flush
+    std::future<void> flush() {
+        size_t logs_posted = logs_posted_();
+        posted_flushes_.fetch_add(1, std::memory_order_relaxed);
+        return thread_pool_->post_flush(backend_.get(), logs_posted, overflow_policy_);
+    }
 protected:
     void sink_it_(const log_msg& msg) override {
-        if (auto pool_ptr = thread_pool_.lock()) {
-            pool_ptr->post_log(shared_from_this(), msg, overflow_policy_);
-        } else {
-            throw std::runtime_error("async log: thread pool doesn't exist anymore");
-        }
+        posted_[posted_slot_()].count.fetch_add(1, std::memory_order_relaxed);
+        thread_pool_->post_log(backend_.get(), msg, overflow_policy_);
 
         if (should_flush_(msg)) {
-            backend_flush_();
-        }
-    }
-    // void flush_() override;
-    void backend_sink_it_(const log_msg& incoming_log_msg) {
-        for (auto& sink : sinks_) {
-            if (sink->should_log(incoming_log_msg.level)) {
-                sink->log(incoming_log_msg);
-            }
+            flush_();
         }
     }
-    void backend_flush_() {
-        for (auto& sink : sinks_) {
-            sink->flush();
-        }
+    // fire and forget, the future is dropped
+    void flush_() override {
+        (void)flush();
     }
 
 private:
-    std::weak_ptr<thread_pool> thread_pool_;
+    // one counter per group of producer threads, so posting only touches a line
+    // that usually stays in the producer's cache
+    struct alignas(cache_line_size) padded_count {
+        std::atomic<size_t> count{0};
+    };
+    static constexpr size_t posted_slots = 16;
+
+    std::shared_ptr<thread_pool> thread_pool_;
     async_overflow_policy overflow_policy_;
+    std::array<padded_count, posted_slots> posted_;
+    std::atomic<size_t> posted_flushes_{0};
+    std::unique_ptr<details::async_backend> backend_;
+
+    // may count records of other threads that aren't queued yet, never misses one posted before
+    size_t logs_posted_() const {
+        size_t posted = 0;
+        for (auto& slot : posted_) {
+            posted += slot.count.load(std::memory_order_relaxed);
+        }
+        return posted;
+    }
+
+    static size_t posted_slot_() {
+        static std::atomic<size_t> next_slot{0};
+        thread_local const size_t slot = next_slot.fetch_add(1, std::memory_order_relaxed) % posted_slots;
+        return slot;
+    }
+
 };
 
 template <async_overflow_policy OverflowPolicy = async_overflow_policy::block>
@@ -72,15 +170,20 @@ struct async_factory_impl {
     static std::shared_ptr<async_logger> create(std::string logger_name, SinkArgs&&... args) {
         auto& registry_inst = registry::get_instance();
 
-        std::unique_lock<std::recursive_mutex> tp_lock(registry_inst.tp_mutex());
-        auto tp = registry_inst.get_tp();
-        if (tp == nullptr) {
-            tp = std::make_shared<thread_pool>(default_async_q_size, 1U);
-            registry_inst.set_tp(tp);
+        std::shared_ptr<thread_pool> tp;
+        {
+            std::unique_lock<std::recursive_mutex> tp_lock(registry_inst.tp_mutex());
+            tp = registry_inst.get_tp();
+            if (tp == nullptr) {
+                tp = std::make_shared<thread_pool>(default_async_q_size, 1U);
+                registry_inst.set_tp(tp);
+            }
         }
 
         auto sink = std::make_shared<Sink>(std::forward<SinkArgs>(args)...);
         auto new_logger = std::make_shared<async_logger>(std::move(logger_name), std::move(sink), std::move(tp), OverflowPolicy);
+        // registered like synchronous_factory's, flush_all, flush_every and set_levels reach it
+        registry_inst.register_logger(new_logger);
         return new_logger;
     }
 };
@@ -113,6 +216,11 @@ inline void init_thread_pool(size_t q_size, size_t thread_count) {
     init_thread_pool(q_size, thread_count, [] {}, [] {});
 }
 
+inline void init_thread_pool(size_t q_size, size_t thread_count, async_queue_kind queue_kind) {
+    auto tp = std::make_shared<thread_pool>(q_size, thread_count, queue_kind);
+    registry::get_instance().set_tp(std::move(tp));
+}
+
 inline std::shared_ptr<thread_pool> thread_pool() {
     return registry::get_instance().get_tp();
 }
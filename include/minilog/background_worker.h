@@ -0,0 +1,96 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace minilog {
+
+// one thread running posted tasks in order, used by sinks to keep slow
+// filesystem work off the logging path. pending tasks still run on destruction.
+// a low priority worker runs under SCHED_IDLE on linux, for cpu heavy work like compression
+class background_worker {
+public:
+    explicit background_worker(bool low_priority = false)
+        : thread_([this, low_priority](std::stop_token stop) {
+              if (low_priority) {
+                  lower_priority_();
+              }
+              run_(stop);
+          }) {}
+
+    ~background_worker() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            thread_.request_stop();
+        }
+        cv_.notify_all();
+    }
+
+    background_worker(const background_worker &) = delete;
+    background_worker &operator=(const background_worker &) = delete;
+
+    void post(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            tasks_.push_back(std::move(task));
+        }
+        cv_.notify_one();
+    }
+
+    // blocks until everything posted so far has run
+    void wait_idle() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        idle_cv_.wait(lock, [this] { return tasks_.empty() && !busy_; });
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::condition_variable idle_cv_;
+    std::deque<std::function<void()>> tasks_;
+    bool busy_{false};
+    // declared last so the members above outlive the thread
+    std::jthread thread_;
+
+    static void lower_priority_() {
+#ifdef __linux__
+        sched_param param{};
+        param.sched_priority = 0;
+        pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+#endif
+    }
+
+    void run_(std::stop_token stop) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            cv_.wait(lock, [&] { return !tasks_.empty() || stop.stop_requested(); });
+            if (tasks_.empty()) {
+                return;
+            }
+            auto task = std::move(tasks_.front());
+            tasks_.pop_front();
+            busy_ = true;
+            lock.unlock();
+            try {
+                task();
+            } catch (const std::exception &ex) {
+                std::fprintf(stderr, "minilog background task failed: %s\n", ex.what());
+            }
+            lock.lock();
+            busy_ = false;
+            idle_cv_.notify_all();
+        }
+    }
+};
+
+}
@@ -0,0 +1,279 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <source_location>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <minilog/common.h>
+#include <minilog/log_msg.h>
+
+namespace minilog {
+namespace details {
+// output iterator over a fixed span, whatever doesn't fit is dropped
+class truncating_iterator {
+public:
+    using iterator_category = std::output_iterator_tag;
+    using value_type = void;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = void;
+
+    truncating_iterator(char *pos, char *end) : pos_(pos), end_(end) {}
+
+    truncating_iterator &operator*() { return *this; }
+    truncating_iterator &operator++() { return *this; }
+    truncating_iterator &operator++(int) { return *this; }
+    truncating_iterator &operator=(char c) {
+        if (pos_ != end_) {
+            *pos_++ = c;
+        }
+        return *this;
+    }
+
+    char *pos() const { return pos_; }
+
+private:
+    char *pos_;
+    char *end_;
+};
+}
+
+// ring of the last messages a logger filtered out by level. every slot and its text
+// are allocated by enable(), a message is formatted into a per thread scratch buffer
+// and cut at slot_size bytes before the lock is taken, the lock only covers copying it
+// into its slot. dump() swaps the ring with a spare one and writes the messages out
+// after letting go of the lock, so a slow sink never holds up the threads capturing
+class backtracer {
+public:
+    static constexpr size_t default_slot_size = 512;
+
+    backtracer() = default;
+
+    backtracer(const backtracer &other) {
+        std::scoped_lock lock(other.dump_mutex_, other.mutex_);
+        copy_from_(other);
+    }
+
+    backtracer(backtracer &&other) noexcept {
+        std::scoped_lock lock(other.dump_mutex_, other.mutex_);
+        move_from_(other);
+    }
+
+    backtracer &operator=(backtracer other) noexcept {
+        swap(other);
+        return *this;
+    }
+
+    void swap(backtracer &other) noexcept {
+        if (this == &other) {
+            return;
+        }
+        std::scoped_lock lock(dump_mutex_, mutex_, other.dump_mutex_, other.mutex_);
+        active_.swap(other.active_);
+        spare_.swap(other.spare_);
+        std::swap(head_, other.head_);
+        std::swap(count_, other.count_);
+        other.slot_size_.store(slot_size_.exchange(other.slot_size_.load()));
+        other.enabled_.store(enabled_.exchange(other.enabled_.load()));
+        other.trigger_level_.store(trigger_level_.exchange(other.trigger_level_.load()));
+    }
+
+    // keeps the last n_messages, a message at or above trigger_level dumps them
+    void enable(size_t n_messages, level::level_enum trigger_level = level::error, size_t slot_size = default_slot_size) {
+        if (n_messages == 0 || slot_size == 0) {
+            throw std::runtime_error("backtracer: n_messages and slot_size must be positive");
+        }
+        std::scoped_lock lock(dump_mutex_, mutex_);
+        active_ = ring(n_messages, slot_size);
+        spare_ = ring(n_messages, slot_size);
+        slot_size_.store(slot_size, std::memory_order_relaxed);
+        head_ = 0;
+        count_ = 0;
+        trigger_level_.store(trigger_level, std::memory_order_relaxed);
+        enabled_.store(true, std::memory_order_relaxed);
+    }
+
+    void disable() {
+        std::scoped_lock lock(dump_mutex_, mutex_);
+        enabled_.store(false, std::memory_order_relaxed);
+        active_ = ring();
+        spare_ = ring();
+        slot_size_.store(0, std::memory_order_relaxed);
+        head_ = 0;
+        count_ = 0;
+    }
+
+    bool enabled() const {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+
+    bool should_dump(level::level_enum msg_level) const {
+        return enabled() && msg_level >= trigger_level_.load(std::memory_order_relaxed) && msg_level != level::off;
+    }
+
+    // format_payload(truncating_iterator) writes the message text and returns the iterator past it
+    template <typename FormatPayload>
+    void push(level::level_enum lvl, const std::source_location &location, FormatPayload &&format_payload) {
+        size_t slot_size = slot_size_.load(std::memory_order_relaxed);
+        auto &scratch = scratch_();
+        // a formatter that logs itself would write over the text being formatted, skip it
+        if (slot_size == 0 || scratch.in_use) {
+            return;
+        }
+        auto time = log_clock::now();
+        scratch.reserve(slot_size);
+        scratch.in_use = true;
+        auto end = format_payload(details::truncating_iterator(scratch.data.get(), scratch.data.get() + slot_size));
+        scratch.in_use = false;
+        size_t size = static_cast<size_t>(end.pos() - scratch.data.get());
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (active_.slots.empty()) {
+            return;
+        }
+        // enable() may have changed the slot size since it was read
+        size_t current_slot_size = slot_size_.load(std::memory_order_relaxed);
+        size = std::min(size, current_slot_size);
+        std::memcpy(active_.text.get() + head_ * current_slot_size, scratch.data.get(), size);
+        active_.slots[head_] = slot{lvl, time, location, size};
+        head_ = (head_ + 1) % active_.slots.size();
+        count_ = std::min(count_ + 1, active_.slots.size());
+    }
+
+    void push(level::level_enum lvl, const std::source_location &location, std::string_view payload) {
+        push(lvl, location, [payload](details::truncating_iterator out) {
+            for (char c : payload) {
+                out = c;
+            }
+            return out;
+        });
+    }
+
+    // hands the stored messages to fn oldest first and empties the ring. fn runs without the
+    // lock push() takes, concurrent dumps wait for each other
+    template <typename Fn>
+    void dump(const std::string &logger_name, Fn &&fn) {
+        std::lock_guard<std::mutex> dump_lock(dump_mutex_);
+        size_t first;
+        size_t count;
+        size_t slot_size;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (active_.slots.empty()) {
+                return;
+            }
+            count = count_;
+            first = (head_ + active_.slots.size() - count_) % active_.slots.size();
+            slot_size = slot_size_.load(std::memory_order_relaxed);
+            // capturing goes on in the other ring
+            active_.swap(spare_);
+            head_ = 0;
+            count_ = 0;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            size_t index = (first + i) % spare_.slots.size();
+            const slot &s = spare_.slots[index];
+            log_msg msg(logger_name, s.level, std::string_view(spare_.text.get() + index * slot_size, s.size), s.location);
+            msg.time = s.time;
+            fn(msg);
+        }
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return count_;
+    }
+
+private:
+    struct slot {
+        level::level_enum level{level::off};
+        log_clock::time_point time;
+        std::source_location location;
+        size_t size{0};
+    };
+
+    // slot i owns text[i * slot_size, (i + 1) * slot_size)
+    struct ring {
+        std::vector<slot> slots;
+        std::unique_ptr<char[]> text;
+
+        ring() = default;
+        ring(size_t n_messages, size_t slot_size)
+            : slots(n_messages), text(std::make_unique<char[]>(n_messages * slot_size)) {}
+
+        void swap(ring &other) noexcept {
+            slots.swap(other.slots);
+            text.swap(other.text);
+        }
+    };
+
+    // grows to the largest slot size used on the thread, then stays
+    struct scratch_buffer {
+        std::unique_ptr<char[]> data;
+        size_t capacity{0};
+        bool in_use{false};
+
+        void reserve(size_t size) {
+            if (capacity < size) {
+                data = std::make_unique<char[]>(size);
+                capacity = size;
+            }
+        }
+    };
+
+    static scratch_buffer &scratch_() {
+        thread_local scratch_buffer scratch;
+        return scratch;
+    }
+
+    // taken before mutex_ when both are needed
+    mutable std::mutex dump_mutex_;
+    mutable std::mutex mutex_;
+    std::atomic<bool> enabled_{false};
+    std::atomic<int> trigger_level_{level::error};
+    std::atomic<size_t> slot_size_{0};
+    // written by push() under mutex_
+    ring active_;
+    // what the last dump() wrote out, only touched under dump_mutex_
+    ring spare_;
+    size_t head_{0};
+    size_t count_{0};
+
+    void copy_from_(const backtracer &other) {
+        size_t slot_size = other.slot_size_.load();
+        size_t n_messages = other.active_.slots.size();
+        if (n_messages > 0) {
+            active_ = ring(n_messages, slot_size);
+            spare_ = ring(n_messages, slot_size);
+            active_.slots = other.active_.slots;
+            std::copy_n(other.active_.text.get(), n_messages * slot_size, active_.text.get());
+        }
+        slot_size_.store(slot_size);
+        head_ = other.head_;
+        count_ = other.count_;
+        enabled_.store(other.enabled_.load());
+        trigger_level_.store(other.trigger_level_.load());
+    }
+
+    void move_from_(backtracer &other) {
+        active_ = std::move(other.active_);
+        spare_ = std::move(other.spare_);
+        slot_size_.store(other.slot_size_.exchange(0));
+        head_ = std::exchange(other.head_, 0);
+        count_ = std::exchange(other.count_, 0);
+        enabled_.store(other.enabled_.exchange(false));
+        trigger_level_.store(other.trigger_level_.load());
+    }
+};
+
+}
@@ -0,0 +1,227 @@
+#pragma once
+
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+#include <minilog/common.h>
+#include <minilog/deferred_args.h>
+
+// layout of the files written by binary_file_sink and read by minilog-decode,
+// integers are varints unless noted, fixed width values use host byte order
+//
+//   header: "MLOGBIN1", int64 base time (ns since epoch)
+//   site:   'S', id, uint8 level, line, file, logger name, format string
+//   log:    'L', site id, zigzag time delta to the previous record (ns), args size, args
+//
+// strings are a varint size followed by the bytes, args use the tagged encoding of deferred_args.h
+namespace minilog::binary {
+
+inline constexpr std::string_view magic = "MLOGBIN1";
+
+enum class record_kind : char {
+    site = 'S',
+    log = 'L'
+};
+
+inline void write_varint(uint64_t value, memory_buf_t &dest) {
+    while (value >= 0x80) {
+        dest.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    dest.push_back(static_cast<char>(value));
+}
+
+inline uint64_t zigzag(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+inline int64_t unzigzag(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+inline void write_string(std::string_view str, memory_buf_t &dest) {
+    write_varint(str.size(), dest);
+    dest.append(str);
+}
+
+// bounds checked cursor over an in memory file
+class reader {
+public:
+    explicit reader(std::string_view data) : data_(data) {}
+
+    bool at_end() const {
+        return pos_ == data_.size();
+    }
+
+    bool read_byte(uint8_t &value) {
+        if (pos_ >= data_.size()) {
+            return false;
+        }
+        value = static_cast<uint8_t>(data_[pos_++]);
+        return true;
+    }
+
+    bool read_varint(uint64_t &value) {
+        value = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7) {
+            uint8_t byte;
+            if (!read_byte(byte)) {
+                return false;
+            }
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool read_bytes(size_t size, std::string_view &bytes) {
+        if (data_.size() - pos_ < size) {
+            return false;
+        }
+        bytes = data_.substr(pos_, size);
+        pos_ += size;
+        return true;
+    }
+
+    bool read_string(std::string_view &str) {
+        uint64_t size;
+        return read_varint(size) && read_bytes(size, str);
+    }
+
+    template <typename T>
+    bool read_raw(T &value) {
+        std::string_view bytes;
+        if (!read_bytes(sizeof(T), bytes)) {
+            return false;
+        }
+        std::memcpy(&value, bytes.data(), sizeof(T));
+        return true;
+    }
+
+private:
+    std::string_view data_;
+    size_t pos_{0};
+};
+
+using decoded_arg = std::variant<bool, char, int64_t, uint64_t, double, std::string_view>;
+
+// walks tagged arguments and hands each value to fn as one of the decoded_arg types,
+// fails on truncated input and on opaque user types
+template <typename Fn>
+bool for_each_arg(std::string_view args, Fn &&fn) {
+    reader in(args);
+    while (!in.at_end()) {
+        uint8_t tag;
+        in.read_byte(tag);
+        switch (static_cast<arg_tag>(tag)) {
+        case arg_tag::boolean: {
+            uint8_t value;
+            if (!in.read_byte(value)) return false;
+            fn(value != 0);
+            break;
+        }
+        case arg_tag::character: {
+            uint8_t value;
+            if (!in.read_byte(value)) return false;
+            fn(static_cast<char>(value));
+            break;
+        }
+        case arg_tag::signed_integer: {
+            int64_t value;
+            if (!in.read_raw(value)) return false;
+            fn(value);
+            break;
+        }
+        case arg_tag::unsigned_integer: {
+            uint64_t value;
+            if (!in.read_raw(value)) return false;
+            fn(value);
+            break;
+        }
+        case arg_tag::floating_point: {
+            double value;
+            if (!in.read_raw(value)) return false;
+            fn(value);
+            break;
+        }
+        case arg_tag::string: {
+            uint32_t size;
+            std::string_view value;
+            if (!in.read_raw(size) || !in.read_bytes(size, value)) return false;
+            fn(value);
+            break;
+        }
+        default:
+            return false;
+        }
+    }
+    return true;
+}
+
+inline bool decode_args(std::string_view args, std::vector<decoded_arg> &out) {
+    out.clear();
+    return for_each_arg(args, [&out](auto value) { out.emplace_back(value); });
+}
+
+// called per record by binary_file_sink, only walks the tags
+inline bool has_opaque_args(std::string_view args) {
+    return !for_each_arg(args, [](auto) {});
+}
+
+// std::vformat for arguments whose types are only known at run time: every
+// replacement field is formatted on its own with its own format spec
+inline void format_decoded(std::string_view format, const std::vector<decoded_arg> &args, memory_buf_t &dest) {
+    size_t next_index = 0;
+    for (size_t i = 0; i < format.size(); ++i) {
+        char c = format[i];
+        if ((c == '{' || c == '}') && i + 1 < format.size() && format[i + 1] == c) {
+            dest.push_back(c);
+            ++i;
+            continue;
+        }
+        if (c != '{') {
+            dest.push_back(c);
+            continue;
+        }
+        auto close = format.find('}', i);
+        if (close == std::string_view::npos) {
+            dest.append(format.substr(i));
+            return;
+        }
+        std::string_view field = format.substr(i + 1, close - i - 1);
+        auto colon = field.find(':');
+        std::string_view index_part = field.substr(0, colon);
+        size_t index = next_index++;
+        if (!index_part.empty()) {
+            std::from_chars(index_part.data(), index_part.data() + index_part.size(), index);
+        }
+        std::string replacement = "{";
+        if (colon != std::string_view::npos) {
+            replacement.append(field.substr(colon));
+        }
+        replacement.push_back('}');
+
+        if (index < args.size()) {
+            std::visit([&](const auto &value) {
+                try {
+                    std::vformat_to(std::back_inserter(dest), replacement, std::make_format_args(value));
+                } catch (const std::format_error &) {
+                    dest.append(std::string_view("{?}"));
+                }
+            }, args[index]);
+        } else {
+            dest.append(std::string_view("{?}"));
+        }
+        i = close;
+    }
+}
+}
@@ -0,0 +1,251 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+namespace minilog {
+// variable length records stored back to back in one preallocated byte buffer,
+// bounded by bytes rather than items. each record is prefixed with its padded entry
+// size and its byte count, both uint32. a record never wraps, the tail of the buffer
+// is skipped with a wrap marker instead. consumers copy whole records out under the lock
+class byte_ring_queue {
+public:
+    // told about every record dropped by enqueue_nowait or left over at destruction
+    using drop_fn = void (*)(std::span<const char> record);
+
+    static constexpr size_t prefix_size = sizeof(uint32_t);
+    static constexpr size_t record_alignment = 8;
+
+    byte_ring_queue(size_t capacity_bytes, drop_fn on_drop)
+        : capacity_(align_(capacity_bytes)),
+          on_drop_(on_drop),
+          ring_(capacity_) {
+        if (capacity_ < 64 * record_alignment || capacity_ > (size_t{1} << 31)) {
+            throw std::runtime_error("byte_ring_queue capacity must be between 512 bytes and 2 GiB");
+        }
+    }
+
+    ~byte_ring_queue() {
+        while (used_ > 0) {
+            drop_oldest_();
+        }
+    }
+
+    byte_ring_queue(const byte_ring_queue &) = delete;
+    byte_ring_queue& operator=(const byte_ring_queue &) = delete;
+
+    // largest record body accepted, bigger ones have to be cut down by the caller
+    size_t max_record_size() const {
+        return capacity_ / 4 - prefix_size;
+    }
+
+    size_t capacity() const {
+        return capacity_;
+    }
+
+    // fill(char *dest) writes exactly size bytes
+    template <typename Fill>
+    void enqueue(size_t size, Fill&& fill) {
+        const size_t entry_size = entry_size_(size);
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            pop_cv_.wait(lock, [&] { return has_room_(entry_size); });
+            write_(size, entry_size, fill);
+        }
+        push_cv_.notify_one();
+    }
+
+    template <typename Fill>
+    void enqueue_nowait(size_t size, Fill&& fill) {
+        const size_t entry_size = entry_size_(size);
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            while (!has_room_(entry_size)) {
+                drop_oldest_();
+                ++overrun_counter_;
+            }
+            write_(size, entry_size, fill);
+        }
+        push_cv_.notify_one();
+    }
+
+    template <typename Fill>
+    bool enqueue_if_have_room(size_t size, Fill&& fill) {
+        const size_t entry_size = entry_size_(size);
+        bool pushed = false;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            if (has_room_(entry_size)) {
+                write_(size, entry_size, fill);
+                pushed = true;
+            }
+        }
+        if (pushed) {
+            push_cv_.notify_one();
+        } else {
+            ++discard_counter_;
+        }
+        return pushed;
+    }
+
+    // waits for at least one record, then copies up to max_records into out using the
+    // same prefixed, padded layout. out is cleared first and keeps its capacity,
+    // so a reused vector stops allocating once it has seen the largest batch
+    size_t dequeue_bulk(std::vector<char>& out, size_t max_records) {
+        out.clear();
+        size_t count = 0;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            push_cv_.wait(lock, [this] { return records_ > 0; });
+            while (count < max_records && records_ > 0) {
+                const uint32_t entry = load_prefix_(read_pos_);
+                if (entry & wrap_marker) {
+                    skip_wrap_(entry);
+                    continue;
+                }
+                out.insert(out.end(), ring_.data() + read_pos_, ring_.data() + read_pos_ + entry);
+                consume_(entry);
+                ++count;
+            }
+        }
+        pop_cv_.notify_all();
+        return count;
+    }
+
+    // walks records written by dequeue_bulk
+    template <typename Fn>
+    static void for_each_record(const std::vector<char>& records, Fn&& fn) {
+        size_t pos = 0;
+        while (pos < records.size()) {
+            uint32_t entry;
+            std::memcpy(&entry, records.data() + pos, prefix_size);
+            uint32_t size;
+            std::memcpy(&size, records.data() + pos + prefix_size, sizeof(size));
+            fn(std::span<const char>(records.data() + pos + 2 * prefix_size, size));
+            pos += entry;
+        }
+    }
+
+    size_t overrun_counter() {
+        return overrun_counter_.load(std::memory_order_relaxed);
+    }
+    size_t discard_counter() {
+        return discard_counter_.load(std::memory_order_relaxed);
+    }
+    size_t size() {
+        std::unique_lock<std::mutex> lock(queue_mutex_);
+        return records_;
+    }
+    size_t bytes_used() {
+        std::unique_lock<std::mutex> lock(queue_mutex_);
+        return used_;
+    }
+    void reset_overrun_counter() {
+        overrun_counter_.store(0, std::memory_order_relaxed);
+    }
+    void reset_discard_counter() {
+        discard_counter_.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    // set on the prefix of the filler at the end of the buffer
+    static constexpr uint32_t wrap_marker = uint32_t{1} << 31;
+
+    size_t capacity_;
+    drop_fn on_drop_;
+    std::vector<char> ring_;
+    size_t read_pos_{0};
+    size_t write_pos_{0};
+    size_t used_{0};
+    size_t records_{0};
+
+    std::mutex queue_mutex_;
+    std::condition_variable push_cv_;
+    std::condition_variable pop_cv_;
+    std::atomic<size_t> overrun_counter_{0};
+    std::atomic<size_t> discard_counter_{0};
+
+    static size_t align_(size_t n) {
+        return (n + record_alignment - 1) & ~(record_alignment - 1);
+    }
+
+    // entry = prefix holding the entry size, body size, body, padding
+    size_t entry_size_(size_t size) const {
+        if (size > max_record_size()) {
+            throw std::runtime_error("byte_ring_queue record larger than max_record_size()");
+        }
+        return align_(2 * prefix_size + size);
+    }
+
+    uint32_t load_prefix_(size_t pos) const {
+        uint32_t entry;
+        std::memcpy(&entry, ring_.data() + pos, prefix_size);
+        return entry;
+    }
+
+    bool has_room_(size_t entry_size) {
+        if (used_ == 0) {
+            read_pos_ = write_pos_ = 0;
+            return entry_size <= capacity_;
+        }
+        if (write_pos_ > read_pos_) {
+            // room at the end, or at the front once the end is skipped
+            return entry_size <= capacity_ - write_pos_ || entry_size <= read_pos_;
+        }
+        return write_pos_ < read_pos_ && entry_size <= read_pos_ - write_pos_;
+    }
+
+    template <typename Fill>
+    void write_(size_t size, size_t entry_size, Fill& fill) {
+        if (write_pos_ >= read_pos_ && entry_size > capacity_ - write_pos_) {
+            const auto filler = static_cast<uint32_t>(capacity_ - write_pos_);
+            const uint32_t marker = filler | wrap_marker;
+            std::memcpy(ring_.data() + write_pos_, &marker, prefix_size);
+            used_ += filler;
+            write_pos_ = 0;
+        }
+        const auto entry = static_cast<uint32_t>(entry_size);
+        const auto body_size = static_cast<uint32_t>(size);
+        std::memcpy(ring_.data() + write_pos_, &entry, prefix_size);
+        std::memcpy(ring_.data() + write_pos_ + prefix_size, &body_size, prefix_size);
+        fill(ring_.data() + write_pos_ + 2 * prefix_size);
+        write_pos_ += entry_size;
+        if (write_pos_ == capacity_) {
+            write_pos_ = 0;
+        }
+        used_ += entry_size;
+        ++records_;
+    }
+
+    void skip_wrap_(uint32_t entry) {
+        used_ -= entry & ~wrap_marker;
+        read_pos_ = 0;
+    }
+
+    void consume_(uint32_t entry) {
+        read_pos_ += entry;
+        if (read_pos_ == capacity_) {
+            read_pos_ = 0;
+        }
+        used_ -= entry;
+        --records_;
+    }
+
+    void drop_oldest_() {
+        uint32_t entry = load_prefix_(read_pos_);
+        if (entry & wrap_marker) {
+            skip_wrap_(entry);
+            entry = load_prefix_(read_pos_);
+        }
+        uint32_t size;
+        std::memcpy(&size, ring_.data() + read_pos_ + prefix_size, sizeof(size));
+        on_drop_(std::span<const char>(ring_.data() + read_pos_ + 2 * prefix_size, size));
+        consume_(entry);
+    }
+};
+}
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <source_location>
+
+namespace minilog {
+namespace details {
+// state of one call site of one logger
+struct call_site_state {
+    static constexpr uint32_t empty = 0;
+    static constexpr uint32_t claiming = 1;
+    static constexpr uint32_t ready = 2;
+
+    std::atomic<uint32_t> status{empty};
+    // written once by the thread that claims the slot, before status becomes ready
+    const char *file_name{nullptr};
+    uint_least32_t line{0};
+    uint_least32_t column{0};
+    std::atomic<int64_t> window_start{0};
+    std::atomic<uint32_t> window_count{0};
+    std::atomic<uint64_t> suppressed{0};
+    std::atomic<uint64_t> seen{0};
+
+    bool is(const std::source_location &loc) const {
+        return file_name == loc.file_name() && line == loc.line() && column == loc.column();
+    }
+};
+
+// fixed open addressing table of one logger's call sites. a site is its file name, line
+// and column, compared in full. the file name is compared by pointer, the same line
+// compiled into two translation units may get two slots. slots are claimed with a
+// compare-exchange and never released, when the probes run out new sites go unlimited
+class call_site_table {
+public:
+    static constexpr size_t capacity = 1024;
+    static constexpr size_t max_probes = 16;
+
+    call_site_state *find(const std::source_location &loc) {
+        size_t start = hash_(loc);
+        for (size_t i = 0; i < max_probes; ++i) {
+            auto &site = sites_[(start + i) % capacity];
+            uint32_t status = site.status.load(std::memory_order_acquire);
+            if (status == call_site_state::empty &&
+                site.status.compare_exchange_strong(status, call_site_state::claiming, std::memory_order_acquire)) {
+                site.file_name = loc.file_name();
+                site.line = loc.line();
+                site.column = loc.column();
+                site.status.store(call_site_state::ready, std::memory_order_release);
+                return &site;
+            }
+            // another thread is filling in the slot, a few stores away
+            while (status == call_site_state::claiming) {
+                status = site.status.load(std::memory_order_acquire);
+            }
+            if (site.is(loc)) {
+                return &site;
+            }
+        }
+        return nullptr;
+    }
+
+private:
+    std::array<call_site_state, capacity> sites_;
+
+    static size_t hash_(const std::source_location &loc) {
+        uint64_t h = std::hash<const void *>{}(loc.file_name());
+        h ^= (static_cast<uint64_t>(loc.line()) << 20 | loc.column()) * 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        return static_cast<size_t>(h);
+    }
+};
+}
+
+// per call site rate limit and 1-in-n sampling of a logger. both are checked before the
+// message is formatted, with atomics on the call site's slot only. the limit is
+// approximate under contention, a few messages over max_messages may get through. the
+// site table is allocated on the first checked message, a copy starts with its own
+class call_site_limiter {
+public:
+    call_site_limiter() = default;
+
+    ~call_site_limiter() {
+        delete table_.load(std::memory_order_relaxed);
+    }
+
+    call_site_limiter(const call_site_limiter &other)
+        : max_messages_(other.max_messages_.load(std::memory_order_relaxed)),
+          interval_ns_(other.interval_ns_.load(std::memory_order_relaxed)),
+          sample_one_in_(other.sample_one_in_.load(std::memory_order_relaxed)) {}
+
+    call_site_limiter &operator=(const call_site_limiter &other) {
+        max_messages_.store(other.max_messages_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        interval_ns_.store(other.interval_ns_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        sample_one_in_.store(other.sample_one_in_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        return *this;
+    }
+
+    void swap(call_site_limiter &other) noexcept {
+        call_site_limiter tmp(other);
+        other = *this;
+        *this = tmp;
+        auto *table = other.table_.exchange(table_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        table_.store(table, std::memory_order_relaxed);
+    }
+
+    // at most max_messages per interval from each call site, 0 turns the limit off
+    void set_rate_limit(uint32_t max_messages, std::chrono::nanoseconds interval) {
+        interval_ns_.store(interval.count(), std::memory_order_relaxed);
+        max_messages_.store(interval.count() > 0 ? max_messages : 0, std::memory_order_relaxed);
+    }
+
+    // one message out of every one_in_n from each call site, 0 or 1 turns sampling off
+    void set_sampling(uint32_t one_in_n) {
+        sample_one_in_.store(one_in_n > 1 ? one_in_n : 0, std::memory_order_relaxed);
+    }
+
+    bool enabled() const {
+        return max_messages_.load(std::memory_order_relaxed) != 0 || sample_one_in_.load(std::memory_order_relaxed) != 0;
+    }
+
+    // whether the message from loc goes out. when a new rate window opens, suppressed is
+    // set to what the site dropped in the windows before, for the caller to report
+    bool admit(const std::source_location &loc, uint64_t &suppressed) {
+        auto *site = site_table_().find(loc);
+        if (site == nullptr) {
+            return true;
+        }
+        uint32_t one_in = sample_one_in_.load(std::memory_order_relaxed);
+        if (one_in != 0 && site->seen.fetch_add(1, std::memory_order_relaxed) % one_in != 0) {
+            return false;
+        }
+        uint32_t max_messages = max_messages_.load(std::memory_order_relaxed);
+        if (max_messages == 0) {
+            return true;
+        }
+
+        int64_t interval = interval_ns_.load(std::memory_order_relaxed);
+        int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        int64_t start = site->window_start.load(std::memory_order_relaxed);
+        uint64_t carried = 0;
+        if (now - start >= interval && site->window_start.compare_exchange_strong(start, now, std::memory_order_relaxed)) {
+            site->window_count.store(0, std::memory_order_relaxed);
+            carried = site->suppressed.exchange(0, std::memory_order_relaxed);
+        }
+        if (site->window_count.fetch_add(1, std::memory_order_relaxed) < max_messages) {
+            suppressed = carried;
+            return true;
+        }
+        // lost the window to other threads, the count is reported by a later message
+        site->suppressed.fetch_add(carried + 1, std::memory_order_relaxed);
+        return false;
+    }
+
+private:
+    std::atomic<uint32_t> max_messages_{0};
+    std::atomic<int64_t> interval_ns_{0};
+    std::atomic<uint32_t> sample_one_in_{0};
+    std::atomic<details::call_site_table *> table_{nullptr};
+
+    details::call_site_table &site_table_() {
+        auto *table = table_.load(std::memory_order_acquire);
+        if (table != nullptr) {
+            return *table;
+        }
+        auto *created = new details::call_site_table;
+        if (table_.compare_exchange_strong(table, created, std::memory_order_acq_rel)) {
+            return *created;
+        }
+        delete created;
+        return *table;
+    }
+};
+
+}
@@ -1,17 +1,86 @@
 #pragma once
 
-#include <iostream>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <magic_enum.hpp>
 
 #include <minilog/minilog.h>
 #include <minilog/common.h>
 
 namespace minilog::cfg {
-inline void load_env_levels() {
-    const char * env_cstr = std::getenv("MINILOG_LEVEL");
+namespace details {
+inline std::string_view trim(std::string_view s) {
+    while (!s.empty() && std::isspace(static_cast<unsigned char>(s.front()))) {
+        s.remove_prefix(1);
+    }
+    while (!s.empty() && std::isspace(static_cast<unsigned char>(s.back()))) {
+        s.remove_suffix(1);
+    }
+    return s;
+}
+
+// the enum names, case insensitive, plus "warn" and "err"
+inline std::optional<level::level_enum> level_from_name(std::string_view name) {
+    std::string lower(name);
+    for (char &c : lower) {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    if (lower == "warn") {
+        return level::warning;
+    }
+    if (lower == "err") {
+        return level::error;
+    }
+    auto lvl = magic_enum::enum_cast<level::level_enum>(lower);
+    if (!lvl || *lvl == level::n_levels) {
+        return std::nullopt;
+    }
+    return *lvl;
+}
+}
+
+// "info,net=debug,db=warn": a bare level for every logger, name=level for the logger and
+// the log_switches of that name, there is one namespace for both. the bare level doesn't
+// reach switches. a later entry wins, bad entries are reported on stderr and skipped
+inline level_spec parse_levels(std::string_view spec) {
+    level_spec parsed;
+    while (!spec.empty()) {
+        auto comma = spec.find(',');
+        std::string_view entry = details::trim(spec.substr(0, comma));
+        spec = comma == std::string_view::npos ? std::string_view() : spec.substr(comma + 1);
+        if (entry.empty()) {
+            continue;
+        }
+
+        auto equals = entry.find('=');
+        std::string_view name = equals == std::string_view::npos ? std::string_view() : details::trim(entry.substr(0, equals));
+        auto lvl = details::level_from_name(equals == std::string_view::npos ? entry : details::trim(entry.substr(equals + 1)));
+        if (!lvl || (equals != std::string_view::npos && name.empty())) {
+            std::fprintf(stderr, "minilog: ignoring level spec entry \"%.*s\"\n", static_cast<int>(entry.size()), entry.data());
+            continue;
+        }
+        if (equals == std::string_view::npos) {
+            parsed.default_level = *lvl;
+        } else {
+            parsed.levels[std::string(name)] = *lvl;
+        }
+    }
+    return parsed;
+}
+
+// applies the spec to the registered loggers and to the ones registered later
+inline void load_levels(std::string_view spec) {
+    registry::get_instance().set_levels(parse_levels(spec));
+}
+
+inline void load_env_levels(const char *env_var = "MINILOG_LEVEL") {
+    const char *env_cstr = std::getenv(env_var);
     if (env_cstr) {
-        minilog::set_level(magic_enum::enum_cast<minilog::level::level_enum>(env_cstr).value()); 
+        load_levels(env_cstr);
     }
 }
-}
\ No newline at end of file
+}
@@ -2,6 +2,26 @@
 
 #include <memory>
 #include <atomic>
+#include <chrono>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+#include <minilog/memory_buf.h>
+
+#define MINILOG_LEVEL_TRACE 0
+#define MINILOG_LEVEL_DEBUG 1
+#define MINILOG_LEVEL_INFO 2
+#define MINILOG_LEVEL_WARNING 3
+#define MINILOG_LEVEL_ERROR 4
+#define MINILOG_LEVEL_CRITICAL 5
+#define MINILOG_LEVEL_OFF 6
+
+// calls below this level compile to nothing, keep it identical in every translation unit
+#ifndef MINILOG_ACTIVE_LEVEL
+#define MINILOG_ACTIVE_LEVEL MINILOG_LEVEL_TRACE
+#endif
+
 namespace minilog {
 
 template <typename T>
@@ -11,6 +31,14 @@ namespace sinks {
 class sink;
 }
 using level_t = std::atomic<int>;
+using log_clock = std::chrono::system_clock;
+using memory_buf_t = basic_memory_buf<512>;
+
+// renders deferred arguments (see deferred_args.h) into dest
+using deferred_format_fn = void (*)(std::string_view format, std::string_view args, memory_buf_t &dest);
+
+// used to keep producer and consumer side atomics apart
+inline constexpr size_t cache_line_size = 64;
 using sink_ptr = std::shared_ptr<sinks::sink>;
 namespace level {
 enum level_enum : int {
@@ -23,7 +51,22 @@ enum level_enum : int {
     off,
     n_levels
 };
+
+inline constexpr level_enum active_level = static_cast<level_enum>(MINILOG_ACTIVE_LEVEL);
+
+constexpr bool is_active(level_enum lvl) {
+    return lvl >= active_level;
+}
 } // end namespace level
 
 enum class color_mode { always, automatic, never };
+
+// parsed form of a level spec such as "info,net=debug,db=warning", see cfg::parse_levels
+struct level_spec {
+    // for every logger the spec doesn't name
+    std::optional<level::level_enum> default_level;
+    // by name. loggers and log_switches share the names, "net=debug" sets the logger
+    // named net and every switch named net
+    std::unordered_map<std::string, level::level_enum> levels;
+};
 }
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <concepts>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <iterator>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+
+#include <minilog/common.h>
+
+namespace minilog {
+
+// user types opt in to deferred formatting by specializing this to true,
+// they are copied byte for byte and must be trivially copyable and formattable
+template <typename T>
+inline constexpr bool enable_deferred_formatting = false;
+
+// every encoded argument starts with its tag so a reader can walk the
+// arguments without knowing the call site's types
+enum class arg_tag : uint8_t {
+    boolean,
+    character,
+    signed_integer,
+    unsigned_integer,
+    floating_point,
+    string,
+    user
+};
+
+template <typename T>
+concept deferred_string = std::convertible_to<const T &, std::string_view>;
+
+template <typename T>
+concept deferrable_arg = deferred_string<T> ||
+                         (std::is_arithmetic_v<T> && !std::same_as<T, long double>) ||
+                         (enable_deferred_formatting<T> && std::is_trivially_copyable_v<T>);
+
+// type handed to std::format when the argument is decoded
+template <typename T>
+using deferred_value_t = std::conditional_t<deferred_string<T>, std::string_view, T>;
+
+namespace details {
+
+template <typename T>
+void encode_raw(const T &value, memory_buf_t &dest) {
+    auto bytes = std::bit_cast<std::array<char, sizeof(T)>>(value);
+    dest.append(bytes.data(), bytes.data() + bytes.size());
+}
+
+template <typename T>
+T decode_raw(const char *&cursor) {
+    std::array<char, sizeof(T)> bytes;
+    std::memcpy(bytes.data(), cursor, sizeof(T));
+    cursor += sizeof(T);
+    return std::bit_cast<T>(bytes);
+}
+
+inline void encode_bytes(arg_tag tag, std::string_view bytes, memory_buf_t &dest) {
+    dest.push_back(static_cast<char>(tag));
+    encode_raw(static_cast<uint32_t>(bytes.size()), dest);
+    dest.append(bytes);
+}
+} // namespace details
+
+template <typename T>
+    requires deferrable_arg<std::decay_t<T>>
+void encode_arg(const T &value, memory_buf_t &dest) {
+    using arg_type = std::decay_t<T>;
+    if constexpr (deferred_string<arg_type>) {
+        details::encode_bytes(arg_tag::string, std::string_view(value), dest);
+    } else if constexpr (std::same_as<arg_type, bool>) {
+        dest.push_back(static_cast<char>(arg_tag::boolean));
+        dest.push_back(value ? 1 : 0);
+    } else if constexpr (std::same_as<arg_type, char>) {
+        dest.push_back(static_cast<char>(arg_tag::character));
+        dest.push_back(value);
+    } else if constexpr (std::is_integral_v<arg_type> && std::is_signed_v<arg_type>) {
+        dest.push_back(static_cast<char>(arg_tag::signed_integer));
+        details::encode_raw(static_cast<int64_t>(value), dest);
+    } else if constexpr (std::is_integral_v<arg_type>) {
+        dest.push_back(static_cast<char>(arg_tag::unsigned_integer));
+        details::encode_raw(static_cast<uint64_t>(value), dest);
+    } else if constexpr (std::is_floating_point_v<arg_type>) {
+        dest.push_back(static_cast<char>(arg_tag::floating_point));
+        details::encode_raw(static_cast<double>(value), dest);
+    } else {
+        auto bytes = std::bit_cast<std::array<char, sizeof(arg_type)>>(value);
+        details::encode_bytes(arg_tag::user, std::string_view(bytes.data(), bytes.size()), dest);
+    }
+}
+
+template <typename T>
+deferred_value_t<T> decode_arg(const char *&cursor) {
+    ++cursor; // tag
+    if constexpr (deferred_string<T> || (!std::is_arithmetic_v<T>)) {
+        auto size = details::decode_raw<uint32_t>(cursor);
+        const char *bytes = cursor;
+        cursor += size;
+        if constexpr (deferred_string<T>) {
+            return std::string_view(bytes, size);
+        } else {
+            return details::decode_raw<T>(bytes);
+        }
+    } else if constexpr (std::same_as<T, bool>) {
+        return *cursor++ != 0;
+    } else if constexpr (std::same_as<T, char>) {
+        return *cursor++;
+    } else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) {
+        return static_cast<T>(details::decode_raw<int64_t>(cursor));
+    } else if constexpr (std::is_integral_v<T>) {
+        return static_cast<T>(details::decode_raw<uint64_t>(cursor));
+    } else {
+        return static_cast<T>(details::decode_raw<double>(cursor));
+    }
+}
+
+// instantiated per call signature, renders the encoded arguments on the backend thread
+template <typename... Args>
+void format_deferred(std::string_view format, std::string_view args, memory_buf_t &dest) {
+    const char *cursor = args.data();
+    std::tuple<deferred_value_t<Args>...> values{decode_arg<Args>(cursor)...};
+    try {
+        std::apply([&](auto &...decoded) {
+            std::vformat_to(std::back_inserter(dest), format, std::make_format_args(decoded...));
+        }, values);
+    } catch (const std::format_error &e) {
+        dest.append(std::string_view("[format error] "));
+        dest.append(std::string_view(e.what()));
+    }
+}
+}
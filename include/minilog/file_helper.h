@@ -1,26 +1,332 @@
 #pragma once
 
-#include <fstream>
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <minilog/common.h>
+#include <minilog/io_uring_writer.h>
 
 namespace minilog {
 
+// write: a userspace buffer drained with write(2)
+// io_uring: registered buffers submitted through io_uring, falls back to write
+//           when the kernel or the sandbox doesn't allow io_uring
+enum class file_io_backend {
+    write,
+    io_uring
+};
+
+struct file_options {
+    file_io_backend backend{file_io_backend::write};
+    // bytes collected before a write(2), 0 writes every call through. with io_uring
+    // it is the size of each registered buffer
+    size_t buffer_size{64 * 1024};
+    // O_DIRECT with block aligned buffers, write backend only. falls back to the page
+    // cache on filesystems that refuse it
+    bool direct_io{false};
+    // flush() on the sink also runs fdatasync
+    bool sync_on_flush{false};
+};
+
 class file_helper {
 public:
+    // alignment of buffers, lengths and offsets under O_DIRECT
+    static constexpr size_t direct_io_alignment = 4096;
+
     file_helper() = default;
-    file_helper(const std::string &filename) : file_(filename, std::ios::out), filename_(filename) {}
+    explicit file_helper(const std::string &filename, bool truncate = true, file_options options = {}) {
+        open(filename, truncate, options);
+    }
+    ~file_helper() {
+        try {
+            close();
+        } catch (...) {
+        }
+    }
     file_helper(const file_helper &) = delete;
     file_helper &operator=(const file_helper &) = delete;
 
+    // creates missing parent directories, appends to an existing file unless truncate is set
+    void open(const std::string &filename, bool truncate = true, file_options options = {}) {
+        close();
+        filename_ = filename;
+        options_ = options;
+        auto parent = std::filesystem::path(filename).parent_path();
+        std::error_code ec;
+        if (!parent.empty()) {
+            std::filesystem::create_directories(parent, ec);
+        }
+
+        // no O_APPEND, io_uring and O_DIRECT write at explicit offsets
+        int flags = O_CREAT | O_CLOEXEC | (truncate ? O_TRUNC : 0);
+        direct_ = false;
+        if (options.direct_io && options.backend == file_io_backend::write) {
+            fd_ = ::open(filename.c_str(), flags | O_RDWR | O_DIRECT, 0644);
+            direct_ = fd_ >= 0;
+        }
+        if (fd_ < 0) {
+            fd_ = ::open(filename.c_str(), flags | O_WRONLY, 0644);
+        }
+        if (fd_ < 0) {
+            throw_errno_("failed opening file " + filename + " for writing");
+        }
+        off_t end = ::lseek(fd_, 0, SEEK_END);
+        size_ = end > 0 ? static_cast<size_t>(end) : 0;
+
+#ifdef MINILOG_HAS_IO_URING
+        if (options.backend == file_io_backend::io_uring) {
+            try {
+                uring_ = std::make_unique<io_uring_writer>(fd_, size_, round_up_(std::max(options.buffer_size, direct_io_alignment)));
+            } catch (const std::runtime_error &) {
+                uring_.reset();
+            }
+        }
+#endif
+        buffered_ = 0;
+        capacity_ = 0;
+        buffer_.reset();
+        if (backend() == file_io_backend::write && (options.buffer_size > 0 || direct_)) {
+            capacity_ = direct_ ? round_up_(std::max(options.buffer_size, direct_io_alignment)) : options.buffer_size;
+            auto *memory = std::aligned_alloc(direct_io_alignment, round_up_(capacity_));
+            if (memory == nullptr) {
+                throw std::bad_alloc();
+            }
+            buffer_.reset(static_cast<char *>(memory));
+        }
+        if (direct_) {
+            load_partial_block_();
+        }
+    }
+
+    void close() {
+        if (fd_ < 0) {
+            return;
+        }
+        try {
+            flush();
+        } catch (...) {
+            release_();
+            throw;
+        }
+        release_();
+    }
+
+    bool is_open() const {
+        return fd_ >= 0;
+    }
+
     const std::string &filename() const {
         return filename_;
     }
 
-    void write(const std::string &msg) {
-        file_ << msg;
+    const file_options &options() const {
+        return options_;
+    }
+
+    // bytes in the file, counted as they are written
+    size_t size() const {
+        return size_;
+    }
+
+    // which backend the file ended up with after a possible fallback
+    file_io_backend backend() const {
+#ifdef MINILOG_HAS_IO_URING
+        if (uring_) {
+            return file_io_backend::io_uring;
+        }
+#endif
+        return file_io_backend::write;
+    }
+
+    // whether O_DIRECT was asked for and the filesystem accepted it
+    bool direct_io() const {
+        return direct_;
+    }
+
+    void write(const memory_buf_t &buf) {
+        write(buf.data(), buf.size());
+    }
+
+    void write(const char *data, size_t size) {
+        size_ += size;
+#ifdef MINILOG_HAS_IO_URING
+        if (uring_) {
+            uring_->write(data, size);
+            return;
+        }
+#endif
+        if (!direct_ && size >= capacity_) {
+            drain_();
+            write_all_(data, size);
+            return;
+        }
+        while (size > 0) {
+            size_t n = std::min(size, capacity_ - buffered_);
+            std::memcpy(buffer_.get() + buffered_, data, n);
+            buffered_ += n;
+            data += n;
+            size -= n;
+            if (buffered_ == capacity_) {
+                drain_();
+            }
+        }
+    }
+
+    // lets the kernel start on what is buffered without waiting for it, the io_uring
+    // backend submits its current buffer, the write backend keeps buffering
+    void submit() {
+#ifdef MINILOG_HAS_IO_URING
+        if (uring_) {
+            uring_->submit();
+        }
+#endif
+    }
+
+    // everything written so far is handed to the kernel
+    void flush() {
+#ifdef MINILOG_HAS_IO_URING
+        if (uring_) {
+            uring_->flush();
+            return;
+        }
+#endif
+        drain_();
+    }
+
+    // flush(), then waits until the data is on the device
+    void sync() {
+        flush();
+        if (fd_ >= 0 && ::fdatasync(fd_) != 0) {
+            throw_errno_("fdatasync failed on " + filename_);
+        }
+    }
+
+    // "logs/app.txt" -> {"logs/app", ".txt"}, dot files and names without extension keep an empty one
+    static std::pair<std::string, std::string> split_by_extension(const std::string &filename) {
+        auto ext_index = filename.rfind('.');
+        auto folder_index = filename.find_last_of("/\\");
+        if (ext_index == std::string::npos || ext_index == 0 || ext_index == filename.size() - 1 ||
+            (folder_index != std::string::npos && ext_index <= folder_index + 1)) {
+            return {filename, std::string()};
+        }
+        return {filename.substr(0, ext_index), filename.substr(ext_index)};
     }
 private:
-    std::ofstream file_;
+    struct free_deleter {
+        void operator()(char *p) const {
+            std::free(p);
+        }
+    };
+
+    int fd_{-1};
     std::string filename_;
+    file_options options_;
+    size_t size_{0};
+    std::unique_ptr<char, free_deleter> buffer_;
+    size_t capacity_{0};
+    size_t buffered_{0};
+    bool direct_{false};
+    // O_DIRECT: file offset of buffer_[0], always block aligned
+    size_t direct_offset_{0};
+#ifdef MINILOG_HAS_IO_URING
+    std::unique_ptr<io_uring_writer> uring_;
+#endif
+
+    static size_t round_up_(size_t n) {
+        return (n + direct_io_alignment - 1) / direct_io_alignment * direct_io_alignment;
+    }
+
+    [[noreturn]] void throw_errno_(const std::string &what, int err = errno) const {
+        throw std::runtime_error(what + ": " + std::strerror(err));
+    }
+
+    void release_() {
+#ifdef MINILOG_HAS_IO_URING
+        uring_.reset();
+#endif
+        ::close(std::exchange(fd_, -1));
+    }
+
+    // O_DIRECT appends start from the last partial block, read it back into the buffer
+    void load_partial_block_() {
+        direct_offset_ = size_ / direct_io_alignment * direct_io_alignment;
+        buffered_ = size_ - direct_offset_;
+        if (buffered_ == 0) {
+            return;
+        }
+        ssize_t n = ::pread(fd_, buffer_.get(), direct_io_alignment, static_cast<off_t>(direct_offset_));
+        if (n < static_cast<ssize_t>(buffered_)) {
+            throw_errno_("failed reading the last block of " + filename_);
+        }
+    }
+
+    void drain_() {
+        if (buffered_ == 0) {
+            return;
+        }
+        if (!direct_) {
+            write_all_(buffer_.get(), std::exchange(buffered_, 0));
+            return;
+        }
+        // whole blocks only: pad the tail, cut the file back to its real length
+        // and keep the tail buffered so the next drain rewrites that block
+        size_t padded = round_up_(buffered_);
+        std::memset(buffer_.get() + buffered_, 0, padded - buffered_);
+        pwrite_all_(buffer_.get(), padded, direct_offset_);
+        if (padded == buffered_) {
+            direct_offset_ += buffered_;
+            buffered_ = 0;
+            return;
+        }
+        if (::ftruncate(fd_, static_cast<off_t>(direct_offset_ + buffered_)) != 0) {
+            throw_errno_("failed truncating " + filename_);
+        }
+        size_t whole = buffered_ / direct_io_alignment * direct_io_alignment;
+        std::memmove(buffer_.get(), buffer_.get() + whole, buffered_ - whole);
+        direct_offset_ += whole;
+        buffered_ -= whole;
+    }
+
+    void write_all_(const char *data, size_t size) {
+        while (size > 0) {
+            ssize_t written = ::write(fd_, data, size);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw_errno_("failed writing to file " + filename_);
+            }
+            data += written;
+            size -= static_cast<size_t>(written);
+        }
+    }
+
+    void pwrite_all_(const char *data, size_t size, size_t offset) {
+        while (size > 0) {
+            ssize_t written = ::pwrite(fd_, data, size, static_cast<off_t>(offset));
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw_errno_("failed writing to file " + filename_);
+            }
+            data += written;
+            offset += static_cast<size_t>(written);
+            size -= static_cast<size_t>(written);
+        }
+    }
 };
 
-}
\ No newline at end of file
+}
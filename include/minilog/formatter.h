@@ -0,0 +1,16 @@
+#pragma once
+
+#include <memory>
+
+#include <minilog/common.h>
+#include <minilog/log_msg.h>
+
+namespace minilog {
+
+class formatter {
+public:
+    virtual ~formatter() = default;
+    virtual void format(const log_msg &msg, memory_buf_t &dest) = 0;
+    virtual std::unique_ptr<formatter> clone() const = 0;
+};
+}
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+
+#include <minilog/common.h>
+
+#if defined(__linux__) && __has_include(<linux/membarrier.h>)
+#include <linux/membarrier.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define MINILOG_HAS_MEMBARRIER 1
+#endif
+
+namespace minilog::details {
+
+// hazard pointers for objects read through a plain atomic pointer on a hot path. a
+// reader publishes the pointer in its thread's slot before using it, a writer that has
+// unpublished an object frees it once no slot holds it. the writer makes every thread of
+// the process run a full fence with membarrier(2), so publishing only needs a compiler
+// barrier. without membarrier both sides use seq_cst fences
+class hazard_domain {
+public:
+    // pointers one thread can hold at once, i.e. how deep protected calls may nest
+    static constexpr size_t slot_depth = 4;
+
+    struct alignas(cache_line_size) thread_slot {
+        std::array<std::atomic<const void *>, slot_depth> pointers{};
+        std::atomic<bool> owned{false};
+        // only read by the owner thread
+        size_t depth{0};
+        // slots are never freed, the list only grows by threads alive at the same time
+        thread_slot *next{nullptr};
+    };
+
+    static hazard_domain &instance() {
+        static hazard_domain domain;
+        return domain;
+    }
+
+    hazard_domain(const hazard_domain &) = delete;
+    hazard_domain &operator=(const hazard_domain &) = delete;
+
+    // publishes what source points at and returns it, null when this thread already holds
+    // slot_depth pointers or is past destroying its thread_locals. release() undoes it
+    template <typename T>
+    T *protect(const std::atomic<T *> &source, thread_slot *&slot) {
+        slot = current_slot_();
+        if (slot == nullptr || slot->depth == slot_depth) {
+            slot = nullptr;
+            return nullptr;
+        }
+        auto &published = slot->pointers[slot->depth];
+        T *p = source.load(std::memory_order_acquire);
+        while (true) {
+            published.store(p, std::memory_order_relaxed);
+            reader_fence_();
+            T *again = source.load(std::memory_order_acquire);
+            if (again == p) {
+                ++slot->depth;
+                return p;
+            }
+            p = again;
+        }
+    }
+
+    static void release(thread_slot *slot) {
+        --slot->depth;
+        slot->pointers[slot->depth].store(nullptr, std::memory_order_release);
+    }
+
+    // call after p can no longer be loaded from its source, then p may be freed when false.
+    // fence() once before checking a batch of pointers
+    void fence() {
+#ifdef MINILOG_HAS_MEMBARRIER
+        if (membarrier_) {
+            ::syscall(__NR_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0, 0);
+            return;
+        }
+#endif
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+
+    bool in_use(const void *p) const {
+        for (auto *slot = head_.load(std::memory_order_acquire); slot != nullptr; slot = slot->next) {
+            for (auto &pointer : slot->pointers) {
+                if (pointer.load(std::memory_order_acquire) == p) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+private:
+    std::atomic<thread_slot *> head_{nullptr};
+    std::mutex slots_mutex_;
+    bool membarrier_{false};
+
+    // trivially destructible, so reading them needs no thread_local init check
+    static inline thread_local thread_slot *tls_slot_ = nullptr;
+    static inline thread_local bool tls_exited_ = false;
+
+    // gives the slot back when its thread exits
+    struct slot_owner {
+        thread_slot *slot{nullptr};
+        ~slot_owner() {
+            if (slot != nullptr) {
+                slot->owned.store(false, std::memory_order_release);
+            }
+            tls_slot_ = nullptr;
+            tls_exited_ = true;
+        }
+    };
+
+    hazard_domain() {
+#ifdef MINILOG_HAS_MEMBARRIER
+        membarrier_ = ::syscall(__NR_membarrier, MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0, 0) == 0;
+#endif
+        use_fences_.store(!membarrier_, std::memory_order_relaxed);
+    }
+
+    // read by every reader, set once before any slot exists. constant initialized, so no
+    // guard on the read
+    static inline std::atomic<bool> use_fences_{true};
+
+    static void reader_fence_() {
+        if (use_fences_.load(std::memory_order_relaxed)) {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        } else {
+            std::atomic_signal_fence(std::memory_order_seq_cst);
+        }
+    }
+
+    thread_slot *current_slot_() {
+        if (tls_slot_ == nullptr && !tls_exited_) {
+            tls_slot_ = acquire_slot_();
+        }
+        return tls_slot_;
+    }
+
+    thread_slot *acquire_slot_() {
+        thread_local slot_owner owner;
+        std::lock_guard<std::mutex> lock(slots_mutex_);
+        for (auto *slot = head_.load(std::memory_order_relaxed); slot != nullptr; slot = slot->next) {
+            bool expected = false;
+            if (slot->owned.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+                owner.slot = slot;
+                return slot;
+            }
+        }
+        auto *slot = new thread_slot;
+        slot->owned.store(true, std::memory_order_relaxed);
+        slot->next = head_.load(std::memory_order_relaxed);
+        head_.store(slot, std::memory_order_release);
+        owner.slot = slot;
+        return slot;
+    }
+};
+}
@@ -0,0 +1,321 @@
+#pragma once
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define MINILOG_HAS_IO_URING 1
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace minilog {
+
+// appends to a file through io_uring without liburing. the file is registered as fixed
+// file 0 and writes go out of buffer_count registered buffers: a full buffer is submitted
+// with IORING_OP_WRITE_FIXED at its file offset and filling continues in the next one,
+// the caller only waits when it wraps around to a buffer the kernel still owns.
+// throws from the constructor when io_uring isn't available
+class io_uring_writer {
+public:
+    static constexpr unsigned buffer_count = 4;
+    static constexpr size_t default_buffer_size = 256 * 1024;
+
+    io_uring_writer(int fd, uint64_t offset, size_t buffer_size = default_buffer_size)
+        : buffer_size_(buffer_size), offset_(offset) {
+        try {
+            setup_ring_();
+            register_file_(fd);
+            register_buffers_();
+        } catch (...) {
+            release_();
+            throw;
+        }
+    }
+
+    ~io_uring_writer() {
+        try {
+            flush();
+        } catch (...) {
+        }
+        release_();
+    }
+
+    io_uring_writer(const io_uring_writer &) = delete;
+    io_uring_writer &operator=(const io_uring_writer &) = delete;
+
+    void write(const char *data, size_t size) {
+        throw_if_failed_();
+        while (size > 0) {
+            buffer &buf = buffers_[current_];
+            while (buf.in_flight) {
+                reap_(true);
+            }
+            size_t n = std::min(size, buffer_size_ - buf.used);
+            std::memcpy(buf.data + buf.used, data, n);
+            buf.used += n;
+            data += n;
+            size -= n;
+            if (buf.used == buffer_size_) {
+                submit();
+            }
+        }
+    }
+
+    // hands the current buffer to the kernel without waiting for it
+    void submit() {
+        buffer &buf = buffers_[current_];
+        if (buf.used == 0 || buf.in_flight) {
+            return;
+        }
+        buf.offset = offset_;
+        buf.done = 0;
+        buf.in_flight = true;
+        offset_ += buf.used;
+        ++in_flight_;
+        queue_write_(current_);
+        current_ = (current_ + 1) % buffer_count;
+        submit_queued_();
+        reap_(false);
+    }
+
+    // submits what is buffered and waits until the kernel has completed every write
+    void flush() {
+        submit();
+        while (in_flight_ > 0) {
+            reap_(true);
+        }
+        throw_if_failed_();
+    }
+
+private:
+    struct buffer {
+        char *data{nullptr};
+        size_t used{0};
+        size_t done{0};
+        uint64_t offset{0};
+        bool in_flight{false};
+    };
+
+    size_t buffer_size_;
+    uint64_t offset_;
+    int ring_fd_{-1};
+    unsigned current_{0};
+    unsigned in_flight_{0};
+    // entries in the submission ring the kernel hasn't taken yet
+    unsigned to_submit_{0};
+    int error_{0};
+    std::array<buffer, buffer_count> buffers_{};
+    char *buffer_memory_{nullptr};
+
+    void *sq_ring_{MAP_FAILED};
+    void *cq_ring_{MAP_FAILED};
+    size_t sq_ring_size_{0};
+    size_t cq_ring_size_{0};
+    io_uring_sqe *sqes_{static_cast<io_uring_sqe *>(MAP_FAILED)};
+    size_t sqes_size_{0};
+    unsigned *sq_tail_{nullptr};
+    unsigned *sq_mask_{nullptr};
+    unsigned *sq_array_{nullptr};
+    unsigned *cq_head_{nullptr};
+    unsigned *cq_tail_{nullptr};
+    unsigned *cq_mask_{nullptr};
+    io_uring_cqe *cqes_{nullptr};
+
+    [[noreturn]] static void throw_errno_(const char *what, int err) {
+        throw std::runtime_error(std::string("io_uring: ") + what + ": " + std::strerror(err));
+    }
+
+    void throw_if_failed_() {
+        if (error_ != 0) {
+            int err = std::exchange(error_, 0);
+            throw_errno_("write failed", err);
+        }
+    }
+
+    void setup_ring_() {
+        io_uring_params params{};
+        ring_fd_ = static_cast<int>(::syscall(__NR_io_uring_setup, buffer_count * 2, &params));
+        if (ring_fd_ < 0) {
+            throw_errno_("setup failed", errno);
+        }
+        sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single_mmap) {
+            sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+        }
+        sq_ring_ = ::mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+        if (sq_ring_ == MAP_FAILED) {
+            throw_errno_("mapping the submission ring failed", errno);
+        }
+        if (single_mmap) {
+            cq_ring_ = sq_ring_;
+        } else {
+            cq_ring_ = ::mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_CQ_RING);
+            if (cq_ring_ == MAP_FAILED) {
+                throw_errno_("mapping the completion ring failed", errno);
+            }
+        }
+        sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+        sqes_ = static_cast<io_uring_sqe *>(::mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES));
+        if (sqes_ == MAP_FAILED) {
+            throw_errno_("mapping the submission entries failed", errno);
+        }
+
+        auto *sq = static_cast<char *>(sq_ring_);
+        sq_tail_ = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+        sq_mask_ = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+        sq_array_ = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+        auto *cq = static_cast<char *>(cq_ring_);
+        cq_head_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+        cq_tail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+        cq_mask_ = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+    }
+
+    void register_file_(int fd) {
+        if (::syscall(__NR_io_uring_register, ring_fd_, IORING_REGISTER_FILES, &fd, 1) < 0) {
+            throw_errno_("registering the file failed", errno);
+        }
+    }
+
+    void register_buffers_() {
+        void *memory = ::mmap(nullptr, buffer_size_ * buffer_count, PROT_READ | PROT_WRITE,
+                              MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+        if (memory == MAP_FAILED) {
+            throw_errno_("allocating buffers failed", errno);
+        }
+        buffer_memory_ = static_cast<char *>(memory);
+        std::array<iovec, buffer_count> iovecs{};
+        for (unsigned i = 0; i < buffer_count; ++i) {
+            buffers_[i].data = buffer_memory_ + i * buffer_size_;
+            iovecs[i].iov_base = buffers_[i].data;
+            iovecs[i].iov_len = buffer_size_;
+        }
+        if (::syscall(__NR_io_uring_register, ring_fd_, IORING_REGISTER_BUFFERS, iovecs.data(), buffer_count) < 0) {
+            throw_errno_("registering buffers failed", errno);
+        }
+    }
+
+    void release_() {
+        if (ring_fd_ >= 0) {
+            ::close(ring_fd_);
+        }
+        if (sqes_ != MAP_FAILED) {
+            ::munmap(sqes_, sqes_size_);
+        }
+        if (cq_ring_ != MAP_FAILED && cq_ring_ != sq_ring_) {
+            ::munmap(cq_ring_, cq_ring_size_);
+        }
+        if (sq_ring_ != MAP_FAILED) {
+            ::munmap(sq_ring_, sq_ring_size_);
+        }
+        if (buffer_memory_ != nullptr) {
+            ::munmap(buffer_memory_, buffer_size_ * buffer_count);
+        }
+    }
+
+    // puts the unwritten part of buffer index in the submission ring, submit_queued_ hands it over
+    void queue_write_(unsigned index) {
+        buffer &buf = buffers_[index];
+        unsigned tail = *sq_tail_;
+        unsigned slot = tail & *sq_mask_;
+        io_uring_sqe *sqe = &sqes_[slot];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_WRITE_FIXED;
+        sqe->flags = IOSQE_FIXED_FILE;
+        sqe->fd = 0;
+        sqe->addr = reinterpret_cast<uint64_t>(buf.data + buf.done);
+        sqe->len = static_cast<uint32_t>(buf.used - buf.done);
+        sqe->off = buf.offset + buf.done;
+        sqe->buf_index = static_cast<uint16_t>(index);
+        sqe->user_data = index;
+        sq_array_[slot] = slot;
+        std::atomic_ref<unsigned>(*sq_tail_).store(tail + 1, std::memory_order_release);
+        ++to_submit_;
+    }
+
+    // enters the kernel until it has taken every queued entry. never called while reap_
+    // walks the completion ring, the reap_ below may run into this again
+    void submit_queued_() {
+        while (to_submit_ > 0) {
+            long submitted = ::syscall(__NR_io_uring_enter, ring_fd_, to_submit_, 0, 0, nullptr, 0);
+            if (submitted > 0) {
+                to_submit_ -= static_cast<unsigned>(submitted);
+                continue;
+            }
+            if (submitted < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+                throw_errno_("submitting a write failed", errno);
+            }
+            // out of resources or the completion ring is full, make room
+            reap_(false);
+        }
+    }
+
+    // handles the completions that are there, with wait blocks for at least one. short and
+    // interrupted writes are resubmitted once the head has moved past their completions
+    void reap_(bool wait) {
+        unsigned head = *cq_head_;
+        unsigned tail = std::atomic_ref<unsigned>(*cq_tail_).load(std::memory_order_acquire);
+        if (head == tail && wait) {
+            while (::syscall(__NR_io_uring_enter, ring_fd_, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0) {
+                if (errno != EINTR) {
+                    throw_errno_("waiting for completions failed", errno);
+                }
+            }
+            tail = std::atomic_ref<unsigned>(*cq_tail_).load(std::memory_order_acquire);
+        }
+        // a buffer has at most one write in flight, so at most buffer_count resubmissions
+        std::array<unsigned, buffer_count> resubmit;
+        unsigned resubmit_count = 0;
+        for (; head != tail; ++head) {
+            const io_uring_cqe &cqe = cqes_[head & *cq_mask_];
+            unsigned index = static_cast<unsigned>(cqe.user_data);
+            if (!complete_(index, cqe.res)) {
+                resubmit[resubmit_count++] = index;
+            }
+        }
+        std::atomic_ref<unsigned>(*cq_head_).store(head, std::memory_order_release);
+
+        for (unsigned i = 0; i < resubmit_count; ++i) {
+            queue_write_(resubmit[i]);
+        }
+        if (resubmit_count > 0) {
+            submit_queued_();
+        }
+    }
+
+    // false when the rest of the buffer still has to be written
+    bool complete_(unsigned index, int res) {
+        buffer &buf = buffers_[index];
+        if (res == -EINTR || res == -EAGAIN) {
+            return false;
+        }
+        if (res < 0 || res == 0) {
+            error_ = res < 0 ? -res : EIO;
+        } else if (buf.done + static_cast<size_t>(res) < buf.used) {
+            // short write, the rest goes out from the same buffer
+            buf.done += static_cast<size_t>(res);
+            return false;
+        }
+        buf.used = 0;
+        buf.done = 0;
+        buf.in_flight = false;
+        --in_flight_;
+        return true;
+    }
+};
+
+}
+#endif
@@ -15,7 +15,17 @@ struct log_msg {
     std::string_view logger_name;
     level::level_enum level{level::off};
     std::string_view payload;
-    std::chrono::zoned_time<std::chrono::milliseconds> time{std::chrono::current_zone(), std::chrono::time_point_cast<std::chrono::milliseconds>(std::chrono::system_clock::now())};
+    log_clock::time_point time{log_clock::now()};
     std::source_location location;
+
+    // deferred formatting: payload stays empty and is rendered from these on the backend thread
+    std::string_view format_string;
+    std::string_view format_args;
+    deferred_format_fn format_fn{nullptr};
+    bool static_format_string{false};
+
+    // set by the formatter, marks the part of the formatted line to be colored
+    mutable size_t color_range_start{0};
+    mutable size_t color_range_end{0};
 };
 }
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+
+#include <minilog/common.h>
+
+namespace minilog {
+class log_switch;
+
+namespace details {
+// every live log_switch by name, and the levels the last spec gave those names so a
+// switch constructed later starts from them
+class switch_directory {
+public:
+    static switch_directory &instance() {
+        static switch_directory directory;
+        return directory;
+    }
+
+    level::level_enum add(const std::string &name, log_switch *sw, level::level_enum initial) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        switches_.emplace(name, sw);
+        auto found = levels_.find(name);
+        return found == levels_.end() ? initial : found->second;
+    }
+
+    void remove(const std::string &name, log_switch *sw) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto [first, last] = switches_.equal_range(name);
+        for (auto it = first; it != last; ++it) {
+            if (it->second == sw) {
+                switches_.erase(it);
+                return;
+            }
+        }
+    }
+
+    // the switches the spec doesn't name keep their level
+    inline void apply(const level_spec &spec);
+
+private:
+    switch_directory() = default;
+
+    std::mutex mutex_;
+    std::multimap<std::string, log_switch *> switches_;
+    std::unordered_map<std::string, level::level_enum> levels_;
+};
+}
+
+// enables a group of call sites by name, independent of the level of the logger they log
+// through. off until a level spec names it, e.g. MINILOG_LEVEL="info,net.packets=debug".
+// the spec doesn't tell switch names from logger names, a switch named like a logger is
+// set along with it, pick switch names no logger uses unless that is what you want.
+// a disabled call costs one relaxed load and compare, nothing is formatted. meant to live
+// in static storage next to the call sites:
+//     static minilog::log_switch packets("net.packets");
+//     net->log(packets, minilog::level::debug, "sent {}", hex_dump(frame));
+class log_switch {
+public:
+    explicit log_switch(std::string name, level::level_enum initial = level::off) : name_(std::move(name)) {
+        level_.store(details::switch_directory::instance().add(name_, this, initial), std::memory_order_relaxed);
+    }
+
+    ~log_switch() {
+        details::switch_directory::instance().remove(name_, this);
+    }
+
+    log_switch(const log_switch &) = delete;
+    log_switch &operator=(const log_switch &) = delete;
+
+    const std::string &name() const {
+        return name_;
+    }
+
+    void set_level(level::level_enum log_level) {
+        level_.store(log_level, std::memory_order_relaxed);
+    }
+
+    level::level_enum level() const {
+        return static_cast<level::level_enum>(level_.load(std::memory_order_relaxed));
+    }
+
+    bool should_log(level::level_enum msg_level) const {
+        return msg_level >= level_.load(std::memory_order_relaxed) && msg_level != level::off;
+    }
+
+private:
+    std::string name_;
+    level_t level_{level::off};
+};
+
+inline void details::switch_directory::apply(const level_spec &spec) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto &[name, lvl] : spec.levels) {
+        levels_[name] = lvl;
+        auto [first, last] = switches_.equal_range(name);
+        for (auto it = first; it != last; ++it) {
+            it->second->set_level(lvl);
+        }
+    }
+}
+}
@@ -1,12 +1,19 @@
 #pragma once
 
 #include <format>
+#include <iterator>
 #include <string>
+#include <utility>
 #include <vector>
 #include <concepts>
 
+#include <minilog/backtracer.h>
+#include <minilog/call_site_limiter.h>
 #include <minilog/common.h>
+#include <minilog/deferred_args.h>
 #include <minilog/log_msg.h>
+#include <minilog/log_switch.h>
+#include <minilog/pattern_formatter.h>
 #include <minilog/sinks/sink.h>
 
 namespace minilog {
@@ -15,11 +22,20 @@ namespace minilog {
 struct FormatWithLocation {
     std::string_view format;
     std::source_location location;
+    // string literals outlive any queued message, other format strings have to be copied
+    bool is_literal;
+
+    // consteval, so only arrays readable at compile time get here: string literals and
+    // constexpr arrays with static storage. a char buffer on the stack doesn't compile,
+    // pass it as a std::string_view to have it copied
+    template <size_t N>
+    consteval FormatWithLocation(const char (&fmt)[N], std::source_location loc=std::source_location::current()):
+        format(fmt), location(loc), is_literal(true) {}
 
     template <typename T>
-        requires std::convertible_to<T, std::string_view>
+        requires (std::convertible_to<T, std::string_view> && !std::is_array_v<T>)
     FormatWithLocation(const T &fmt, std::source_location loc=std::source_location::current()):
-        format(fmt), location(std::move(loc)) {}
+        format(fmt), location(std::move(loc)), is_literal(false) {}
 };
 
 class logger {
@@ -31,7 +47,8 @@ public:
     template <typename It>
     logger(std::string name, It begin, It end)
         : name_(std::move(name)),
-          sinks_(begin, end) {}
+          sinks_(begin, end),
+          sinks_want_format_args_(any_wants_format_args_(sinks_)) {}
     
     logger(std::string name, sink_ptr single_sink)
         : logger(std::move(name), {std::move(single_sink)}) {}
@@ -42,14 +59,20 @@ public:
     logger(const logger& other)
         : name_(other.name_),
           sinks_(other.sinks_),
+          sinks_want_format_args_(other.sinks_want_format_args_),
           level_(other.level_.load(std::memory_order_relaxed)),
-          flush_level_(other.flush_level_.load(std::memory_order_relaxed)) {}
+          flush_level_(other.flush_level_.load(std::memory_order_relaxed)),
+          backtracer_(other.backtracer_),
+          limiter_(other.limiter_) {}
 
     logger(logger&& other) noexcept
         : name_(std::move(other.name_)),
           sinks_(std::move(other.sinks_)),
+          sinks_want_format_args_(other.sinks_want_format_args_),
           level_(other.level_.load(std::memory_order_relaxed)),
-          flush_level_(other.flush_level_.load(std::memory_order_relaxed)) {}
+          flush_level_(other.flush_level_.load(std::memory_order_relaxed)),
+          backtracer_(std::move(other.backtracer_)),
+          limiter_(other.limiter_) {}
     
     logger& operator=(logger other) noexcept {
         this->swap(other);
@@ -63,6 +86,7 @@ public:
     void swap(logger& other) noexcept {
         name_.swap(other.name_);
         sinks_.swap(other.sinks_);
+        std::swap(sinks_want_format_args_, other.sinks_want_format_args_);
 
         // swap level_
         auto other_level = other.level_.load();
@@ -74,6 +98,9 @@ public:
         other_level = other.flush_level_.load();
         my_level = flush_level_.exchange(other_level);
         other.flush_level_.store(my_level);
+
+        backtracer_.swap(other.backtracer_);
+        limiter_.swap(other.limiter_);
     }
     virtual ~logger() = default;
 
@@ -89,6 +116,59 @@ public:
         return static_cast<level::level_enum>(flush_level_.load(std::memory_order_relaxed));
     }
 
+    // flush after every message at or above log_level
+    void flush_on(level::level_enum log_level) {
+        flush_level_.store(log_level);
+    }
+
+    void flush() {
+        flush_();
+    }
+
+    // messages below the logger level are kept in a ring of the last n_messages instead
+    // of being dropped, and written to the sinks ahead of the next message at or above
+    // trigger_level. each message keeps at most slot_size bytes of text
+    void enable_backtrace(size_t n_messages, level::level_enum trigger_level = level::error,
+                          size_t slot_size = backtracer::default_slot_size) {
+        backtracer_.enable(n_messages, trigger_level, slot_size);
+    }
+
+    // each call site of this logger lets at most max_messages through per interval, the
+    // next message after a window with drops is preceded by a "suppressed" line.
+    // max_messages = 0 turns it off
+    void set_rate_limit(uint32_t max_messages, std::chrono::nanoseconds interval) {
+        limiter_.set_rate_limit(max_messages, interval);
+    }
+
+    // logs one message out of every one_in_n from each call site, 1 turns it off
+    void set_sampling(uint32_t one_in_n) {
+        limiter_.set_sampling(one_in_n);
+    }
+
+    void disable_backtrace() {
+        backtracer_.disable();
+    }
+
+    // writes the kept messages to the sinks now, oldest first
+    void dump_backtrace() {
+        dump_backtrace_();
+    }
+
+    // each sink gets its own copy of the formatter
+    void set_formatter(std::unique_ptr<formatter> new_formatter) {
+        for (auto it = sinks_.begin(); it != sinks_.end(); ++it) {
+            if (std::next(it) == sinks_.end()) {
+                (*it)->set_formatter(std::move(new_formatter));
+                break;
+            }
+            (*it)->set_formatter(new_formatter->clone());
+        }
+    }
+
+    void set_pattern(std::string pattern) {
+        set_formatter(std::make_unique<pattern_formatter>(std::move(pattern)));
+    }
+
     bool should_flush_(const log_msg &msg) {
         auto flush_level = flush_level_.load(std::memory_order_relaxed);
         return (msg.level >= flush_level) && (msg.level != level::off);
@@ -98,89 +178,215 @@ public:
         return msg_level >= level_.load(std::memory_order_relaxed);
     }
 
+    // inlined into the level functions so a filtered call never reaches log()
+    bool wants_(level::level_enum msg_level) const {
+        return should_log(msg_level) || backtracer_.enabled();
+    }
+
     template <typename... Args>
     void log(level::level_enum lvl, FormatWithLocation format_with_location, Args &&...args) {
+        if (!level::is_active(lvl)) return;
         bool log_enabled = should_log(lvl);
-        std::string message = vformat(format_with_location.format, std::make_format_args(args...));
-        log_msg log_message(name_, lvl, message, format_with_location.location);
-        log_it_(log_message, log_enabled);
+        if (!log_enabled) {
+            if (backtracer_.enabled()) {
+                backtracer_.push(lvl, format_with_location.location, [&](details::truncating_iterator out) {
+                    return std::vformat_to(out, format_with_location.format, std::make_format_args(args...));
+                });
+            }
+            return;
+        }
+        log_enabled_(lvl, format_with_location, args...);
+    }
+
+    // for call sites behind a log_switch, the switch decides instead of the logger level
+    template <typename... Args>
+    void log(const log_switch &site, level::level_enum lvl, FormatWithLocation format_with_location, Args &&...args) {
+        if (!level::is_active(lvl) || !site.should_log(lvl)) return;
+        log_enabled_(lvl, format_with_location, args...);
     }
 
     template <typename T>
         requires (!convertible_to_string_view<T>)
     void log(level::level_enum lvl, const T &msg, std::source_location loc=std::source_location::current()) {
-        log(lvl, FormatWithLocation("{}", loc), msg);
+        FormatWithLocation format_with_location(std::string_view("{}"), loc);
+        format_with_location.is_literal = true;
+        log(lvl, format_with_location, msg);
     }
 
     void log(level::level_enum lvl, std::string_view msg, std::source_location loc=std::source_location::current()) {
+        if (!level::is_active(lvl)) return;
         bool log_enabled = should_log(lvl);
-        if (!log_enabled) return;
+        if (!log_enabled) {
+            if (backtracer_.enabled()) {
+                backtracer_.push(lvl, loc, msg);
+            }
+            return;
+        }
+        if (limiter_.enabled() && !admit_(lvl, loc)) {
+            return;
+        }
         log_msg log_message(name_, lvl, msg, loc);
         log_it_(log_message, log_enabled);
     }
 
     template <typename T>
     void trace(const T &msg, std::source_location loc=std::source_location::current()) {
-        log(level::trace, msg, loc);
+        if constexpr (level::is_active(level::trace)) {
+            if (wants_(level::trace)) {
+                log(level::trace, msg, loc);
+            }
+        }
     }
 
     template <typename T>
     void debug(const T &msg, std::source_location loc=std::source_location::current()) {
-        log(level::debug, msg, loc);
+        if constexpr (level::is_active(level::debug)) {
+            if (wants_(level::debug)) {
+                log(level::debug, msg, loc);
+            }
+        }
     }
 
     template <typename T>
     void info(const T &msg, std::source_location loc=std::source_location::current()) {
-        log(level::info, msg, loc);
+        if constexpr (level::is_active(level::info)) {
+            if (wants_(level::info)) {
+                log(level::info, msg, loc);
+            }
+        }
     }
 
     template <typename T>
     void warn(const T &msg, std::source_location loc=std::source_location::current()) {
-        log(level::warning, msg, loc);
+        if constexpr (level::is_active(level::warning)) {
+            if (wants_(level::warning)) {
+                log(level::warning, msg, loc);
+            }
+        }
     }
 
     template <typename T>
     void error(const T &msg, std::source_location loc=std::source_location::current()) {
-        log(level::error, msg, loc);
+        if constexpr (level::is_active(level::error)) {
+            if (wants_(level::error)) {
+                log(level::error, msg, loc);
+            }
+        }
     }
 
     template <typename T>
     void critical(const T &msg, std::source_location loc=std::source_location::current()) {
-        log(level::critical, msg, loc);
+        if constexpr (level::is_active(level::critical)) {
+            if (wants_(level::critical)) {
+                log(level::critical, msg, loc);
+            }
+        }
     }
 
     template <typename... Args>
     void trace(FormatWithLocation fmt, Args &&...args) {
-        log(level::trace, fmt, std::forward<Args>(args)...);
+        if constexpr (level::is_active(level::trace)) {
+            if (wants_(level::trace)) {
+                log(level::trace, fmt, std::forward<Args>(args)...);
+            }
+        }
     }
 
     template <typename... Args>
     void debug(FormatWithLocation fmt, Args &&...args) {
-        log(level::debug, fmt, std::forward<Args>(args)...);
+        if constexpr (level::is_active(level::debug)) {
+            if (wants_(level::debug)) {
+                log(level::debug, fmt, std::forward<Args>(args)...);
+            }
+        }
     }
 
     template <typename... Args>
     void info(FormatWithLocation fmt, Args &&...args) {
-        log(level::info, fmt, std::forward<Args>(args)...);
+        if constexpr (level::is_active(level::info)) {
+            if (wants_(level::info)) {
+                log(level::info, fmt, std::forward<Args>(args)...);
+            }
+        }
     }
 
     template <typename... Args>
     void warn(FormatWithLocation fmt, Args &&...args) {
-        log(level::warning, fmt, std::forward<Args>(args)...);
+        if constexpr (level::is_active(level::warning)) {
+            if (wants_(level::warning)) {
+                log(level::warning, fmt, std::forward<Args>(args)...);
+            }
+        }
     }
 
     template <typename... Args>
     void error(FormatWithLocation fmt, Args &&...args) {
-        log(level::error, fmt, std::forward<Args>(args)...);
+        if constexpr (level::is_active(level::error)) {
+            if (wants_(level::error)) {
+                log(level::error, fmt, std::forward<Args>(args)...);
+            }
+        }
     }
 
     template <typename... Args>
     void critical(FormatWithLocation fmt, Args &&...args) {
-        log(level::critical, fmt, std::forward<Args>(args)...);
+        if constexpr (level::is_active(level::critical)) {
+            if (wants_(level::critical)) {
+                log(level::critical, fmt, std::forward<Args>(args)...);
+            }
+        }
+    }
+
+    // past the level check, rate limited and then formatted here or deferred
+    template <typename... Args>
+    void log_enabled_(level::level_enum lvl, const FormatWithLocation &format_with_location, Args &...args) {
+        if (limiter_.enabled() && !admit_(lvl, format_with_location.location)) {
+            return;
+        }
+        if constexpr ((deferrable_arg<std::decay_t<Args>> && ...)) {
+            if (deferred_formatting_.load(std::memory_order_relaxed)) {
+                log_deferred_(lvl, format_with_location, args...);
+                return;
+            }
+        }
+        memory_buf_t message;
+        std::vformat_to(std::back_inserter(message), format_with_location.format, std::make_format_args(args...));
+        log_msg log_message(name_, lvl, message.view(), format_with_location.location);
+        if constexpr ((deferrable_arg<std::decay_t<Args>> && ...)) {
+            if (sinks_want_format_args_) {
+                memory_buf_t encoded;
+                attach_format_args_(log_message, format_with_location, encoded, args...);
+                log_it_(log_message, true);
+                return;
+            }
+        }
+        log_it_(log_message, true);
+    }
+
+    template <typename... Args>
+    void log_deferred_(level::level_enum lvl, const FormatWithLocation &format_with_location, const Args &...args) {
+        memory_buf_t encoded;
+        log_msg log_message(name_, lvl, {}, format_with_location.location);
+        attach_format_args_(log_message, format_with_location, encoded, args...);
+        log_it_(log_message, true);
+    }
+
+    // encoded has to outlive the message
+    template <typename... Args>
+    static void attach_format_args_(log_msg &log_message, const FormatWithLocation &format_with_location,
+                                    memory_buf_t &encoded, const Args &...args) {
+        (encode_arg(args, encoded), ...);
+        log_message.format_string = format_with_location.format;
+        log_message.format_args = encoded.view();
+        log_message.format_fn = &format_deferred<std::decay_t<Args>...>;
+        log_message.static_format_string = format_with_location.is_literal;
     }
 
     void log_it_(const log_msg &log_message, bool log_enabled)
     {
+        if (backtracer_.should_dump(log_message.level)) {
+            dump_backtrace_();
+        }
         if (log_enabled) {
             sink_it_(log_message);
         }
@@ -192,12 +398,60 @@ public:
                 sink->log(msg);
             }
         }
+        if (should_flush_(msg)) {
+            flush_();
+        }
     }
 protected:
+    // false drops the message, a site that dropped some earlier reports how many first
+    bool admit_(level::level_enum lvl, const std::source_location &loc) {
+        uint64_t suppressed = 0;
+        if (!limiter_.admit(loc, suppressed)) {
+            return false;
+        }
+        if (suppressed > 0) {
+            memory_buf_t message;
+            std::format_to(std::back_inserter(message), "{} messages suppressed by the rate limit", suppressed);
+            log_msg summary(name_, lvl, message.view(), loc);
+            log_it_(summary, true);
+        }
+        return true;
+    }
+
+    static bool any_wants_format_args_(const std::vector<sink_ptr> &sinks) {
+        for (auto &sink : sinks) {
+            if (sink && sink->wants_format_args()) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void dump_backtrace_() {
+        if (!backtracer_.enabled()) {
+            return;
+        }
+        backtracer_.dump(name_, [this](const log_msg &msg) {
+            sink_it_(msg);
+        });
+    }
+
+    virtual void flush_() {
+        for (auto &sink : sinks_) {
+            sink->flush();
+        }
+    }
+
     std::string name_;
     std::vector<sink_ptr> sinks_;
+    // sinks_ is fixed after construction, so is whether formatted messages carry their arguments
+    bool sinks_want_format_args_{false};
     std::atomic<int> level_{level::info};
     std::atomic<int> flush_level_{level::off};
+    // only loggers that render on another thread turn this on
+    std::atomic<bool> deferred_formatting_{false};
+    backtracer backtracer_;
+    call_site_limiter limiter_;
 };
 
 inline void swap(logger& a, logger& b) {
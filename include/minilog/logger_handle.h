@@ -0,0 +1,117 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+#include <minilog/logger.h>
+#include <minilog/registry.h>
+
+namespace minilog {
+namespace details {
+struct string_hash {
+    using is_transparent = void;
+    size_t operator()(std::string_view s) const {
+        return std::hash<std::string_view>{}(s);
+    }
+};
+
+// per thread results of registry::get, dropped as a whole when the registry generation
+// moves. weak, a logger dropped from the registry isn't kept alive by a thread's cache
+struct logger_cache {
+    uint64_t generation{std::numeric_limits<uint64_t>::max()};
+    std::unordered_map<std::string, std::weak_ptr<logger>, string_hash, std::equal_to<>> loggers;
+};
+
+// the generation is read before the registry, so a change racing with the
+// lookup leaves an entry that the next call throws away
+inline std::shared_ptr<logger> cached_get(std::string_view name) {
+    thread_local logger_cache cache;
+    auto &registry_inst = registry::get_instance();
+    uint64_t generation = registry_inst.generation();
+    if (cache.generation != generation) {
+        cache.loggers.clear();
+        cache.generation = generation;
+    }
+    auto found = cache.loggers.find(name);
+    if (found != cache.loggers.end()) {
+        return found->second.lock();
+    }
+    std::string key(name);
+    auto resolved = registry_inst.get(key);
+    cache.loggers.emplace(std::move(key), resolved);
+    return resolved;
+}
+}
+
+// names a registered logger and resolves it with one atomic load and a compare while the
+// registry is unchanged, safe to share between threads, e.g. as a static at the call site.
+// resolving again after a registry change takes a mutex. the handle owns only the logger
+// it resolved last, a previous one goes to the registry's retired loggers and is freed
+// once no logger_ref from get() still points at it
+class logger_handle {
+public:
+    explicit logger_handle(std::string name) : name_(std::move(name)) {}
+
+    logger_handle(const logger_handle &) = delete;
+    logger_handle &operator=(const logger_handle &) = delete;
+
+    const std::string &name() const {
+        return name_;
+    }
+
+    // null while no logger of that name is registered. the logger stays valid while the
+    // returned ref is in scope, don't keep the raw pointer past it
+    details::logger_ref get() const {
+        uint64_t generation = registry::get_instance().generation();
+        if (resolved_generation_.load(std::memory_order_acquire) != generation) {
+            resolve_(generation);
+        }
+        return details::logger_ref(logger_, [this] {
+            std::lock_guard<std::mutex> lock(resolve_mutex_);
+            return owner_;
+        });
+    }
+
+    details::logger_ref operator->() const {
+        return get();
+    }
+
+    explicit operator bool() const {
+        return static_cast<bool>(get());
+    }
+
+private:
+    std::string name_;
+    mutable std::atomic<uint64_t> resolved_generation_{std::numeric_limits<uint64_t>::max()};
+    mutable std::atomic<logger *> logger_{nullptr};
+    mutable std::mutex resolve_mutex_;
+    mutable std::shared_ptr<logger> owner_;
+
+    void resolve_(uint64_t generation) const {
+        auto &registry_inst = registry::get_instance();
+        std::shared_ptr<logger> previous;
+        {
+            std::lock_guard<std::mutex> lock(resolve_mutex_);
+            if (resolved_generation_.load(std::memory_order_relaxed) == generation) {
+                return;
+            }
+            auto resolved = registry_inst.get(name_);
+            logger_.store(resolved.get(), std::memory_order_release);
+            previous = std::exchange(owner_, std::move(resolved));
+            resolved_generation_.store(generation, std::memory_order_release);
+        }
+        if (previous && previous != owner_) {
+            registry_inst.retire_(std::move(previous));
+        }
+    }
+};
+
+}
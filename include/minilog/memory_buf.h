@@ -0,0 +1,135 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <string_view>
+
+namespace minilog {
+
+// growable char buffer, the first InlineSize bytes live inside the object so
+// formatting a typical line never touches the heap
+template <size_t InlineSize>
+class basic_memory_buf {
+public:
+    using value_type = char;
+
+    basic_memory_buf() = default;
+
+    basic_memory_buf(const basic_memory_buf &other) {
+        append(other.begin(), other.end());
+    }
+
+    basic_memory_buf(basic_memory_buf &&other) noexcept {
+        move_from_(other);
+    }
+
+    basic_memory_buf &operator=(const basic_memory_buf &other) {
+        if (this != &other) {
+            clear();
+            append(other.begin(), other.end());
+        }
+        return *this;
+    }
+
+    basic_memory_buf &operator=(basic_memory_buf &&other) noexcept {
+        if (this != &other) {
+            release_();
+            move_from_(other);
+        }
+        return *this;
+    }
+
+    ~basic_memory_buf() {
+        release_();
+    }
+
+    void push_back(char c) {
+        if (size_ == capacity_) {
+            grow_(size_ + 1);
+        }
+        data_[size_++] = c;
+    }
+
+    void append(const char *begin, const char *end) {
+        auto count = static_cast<size_t>(end - begin);
+        reserve(size_ + count);
+        std::memcpy(data_ + size_, begin, count);
+        size_ += count;
+    }
+
+    void append(std::string_view view) {
+        append(view.data(), view.data() + view.size());
+    }
+
+    void reserve(size_t new_capacity) {
+        if (new_capacity > capacity_) {
+            grow_(new_capacity);
+        }
+    }
+
+    void resize(size_t new_size) {
+        reserve(new_size);
+        size_ = new_size;
+    }
+
+    void clear() {
+        size_ = 0;
+    }
+
+    char *data() { return data_; }
+    const char *data() const { return data_; }
+    char *begin() { return data_; }
+    char *end() { return data_ + size_; }
+    const char *begin() const { return data_; }
+    const char *end() const { return data_ + size_; }
+    size_t size() const { return size_; }
+    size_t capacity() const { return capacity_; }
+    bool empty() const { return size_ == 0; }
+
+    char &operator[](size_t pos) { return data_[pos]; }
+    const char &operator[](size_t pos) const { return data_[pos]; }
+
+    std::string_view view() const {
+        return {data_, size_};
+    }
+
+private:
+    void grow_(size_t min_capacity) {
+        size_t new_capacity = std::max(min_capacity, capacity_ + capacity_ / 2);
+        char *new_data = new char[new_capacity];
+        std::memcpy(new_data, data_, size_);
+        release_();
+        data_ = new_data;
+        capacity_ = new_capacity;
+    }
+
+    void release_() {
+        if (data_ != inline_) {
+            delete[] data_;
+            data_ = inline_;
+            capacity_ = InlineSize;
+        }
+    }
+
+    void move_from_(basic_memory_buf &other) {
+        if (other.data_ == other.inline_) {
+            std::memcpy(inline_, other.inline_, other.size_);
+            data_ = inline_;
+            capacity_ = InlineSize;
+        } else {
+            data_ = other.data_;
+            capacity_ = other.capacity_;
+            other.data_ = other.inline_;
+            other.capacity_ = InlineSize;
+        }
+        size_ = other.size_;
+        other.size_ = 0;
+    }
+
+    char inline_[InlineSize];
+    char *data_{inline_};
+    size_t size_{0};
+    size_t capacity_{InlineSize};
+};
+}
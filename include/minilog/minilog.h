@@ -4,12 +4,16 @@
 #include <minilog/registry.h>
 #include <minilog/synchronous_factory.h>
 #include <minilog/logger.h>
+#include <minilog/logger_handle.h>
 
 namespace minilog {
 
-inline std::shared_ptr<logger> get(const std::string &name)
+// served from a per thread cache while the registry is unchanged. the cache holds weak
+// references, a dropped logger isn't kept alive by it. see logger_handle for
+// call sites that look up the same logger every time
+inline std::shared_ptr<logger> get(std::string_view name)
 {
-    return registry::get_instance().get(name);
+    return details::cached_get(name);
 }
 
 inline std::shared_ptr<logger> get_default_logger()
@@ -17,76 +21,121 @@ inline std::shared_ptr<logger> get_default_logger()
     return registry::get_instance().get_default_logger();
 }
 
+// what the free logging functions below log through, valid until set_default_logger
+// replaces it. the free functions don't keep it, they hold a details::default_logger_ref
+inline logger *default_logger_raw() noexcept {
+    return registry::get_instance().default_logger_raw();
+}
+
 inline void set_default_logger(std::shared_ptr<logger> default_logger) {
     registry::get_instance().set_default_logger(std::move(default_logger));
 }
 
 inline void set_level(level::level_enum lvl) {
-    get_default_logger()->set_level(lvl);
+    details::default_logger_ref()->set_level(lvl);
+}
+
+inline void set_pattern(std::string pattern) {
+    details::default_logger_ref()->set_pattern(std::move(pattern));
 }
 
 inline void register_logger(std::shared_ptr<logger> logger) {
     registry::get_instance().register_logger(std::move(logger));
 }
 
+inline void flush_all() {
+    registry::get_instance().flush_all();
+}
+
+template <typename Rep, typename Period>
+void flush_every(std::chrono::duration<Rep, Period> interval) {
+    registry::get_instance().flush_every(interval);
+}
+
+// the level is only read once the ref has published the pointer, a replaced default
+// may be freed as soon as no hazard slot holds it. a filtered call pays for the publish
 template <typename T>
 void trace(const T &msg, std::source_location loc=std::source_location::current()) {
-    get_default_logger()->trace(msg, loc);
+    if constexpr (level::is_active(level::trace)) {
+        details::default_logger_ref()->trace(msg, loc);
+    }
 }
 
 template <typename T>
 void debug(const T &msg, std::source_location loc=std::source_location::current()) {
-    get_default_logger()->debug(msg, loc);
+    if constexpr (level::is_active(level::debug)) {
+        details::default_logger_ref()->debug(msg, loc);
+    }
 }
 
 template <typename T>
 void info(const T &msg, std::source_location loc=std::source_location::current()) {
-    get_default_logger()->info(msg, loc);
+    if constexpr (level::is_active(level::info)) {
+        details::default_logger_ref()->info(msg, loc);
+    }
 }
 
 template <typename T>
 void warn(const T &msg, std::source_location loc=std::source_location::current()) {
-    get_default_logger()->warn(msg, loc);
+    if constexpr (level::is_active(level::warning)) {
+        details::default_logger_ref()->warn(msg, loc);
+    }
 }
 
 template <typename T>
 void error(const T &msg, std::source_location loc=std::source_location::current()) {
-    get_default_logger()->error(msg, loc);
+    if constexpr (level::is_active(level::error)) {
+        details::default_logger_ref()->error(msg, loc);
+    }
 }
 
 template <typename T>
 void critical(const T &msg, std::source_location loc=std::source_location::current()) {
-    get_default_logger()->critical(msg, loc);
+    if constexpr (level::is_active(level::critical)) {
+        details::default_logger_ref()->critical(msg, loc);
+    }
 }
 
 template <typename... Args>
 void trace(FormatWithLocation fmt, Args &&...args) {
-    get_default_logger()->trace(std::move(fmt), std::forward<Args>(args)...);
+    if constexpr (level::is_active(level::trace)) {
+        details::default_logger_ref()->trace(std::move(fmt), std::forward<Args>(args)...);
+    }
 }
 
 template <typename... Args>
 void debug(FormatWithLocation fmt, Args &&...args) {
-    get_default_logger()->debug(std::move(fmt), std::forward<Args>(args)...);
+    if constexpr (level::is_active(level::debug)) {
+        details::default_logger_ref()->debug(std::move(fmt), std::forward<Args>(args)...);
+    }
 }
 
 template <typename... Args>
 void info(FormatWithLocation fmt, Args &&...args) {
-    get_default_logger()->info(std::move(fmt), std::forward<Args>(args)...);
+    if constexpr (level::is_active(level::info)) {
+        details::default_logger_ref()->info(std::move(fmt), std::forward<Args>(args)...);
+    }
 }
 
 template <typename... Args>
 void warn(FormatWithLocation fmt, Args &&...args) {
-    get_default_logger()->warn(std::move(fmt), std::forward<Args>(args)...);
+    if constexpr (level::is_active(level::warning)) {
+        details::default_logger_ref()->warn(std::move(fmt), std::forward<Args>(args)...);
+    }
 }
 
 template <typename... Args>
 void error(FormatWithLocation fmt, Args &&...args) {
-    get_default_logger()->error(std::move(fmt), std::forward<Args>(args)...);
+    if constexpr (level::is_active(level::error)) {
+        details::default_logger_ref()->error(std::move(fmt), std::forward<Args>(args)...);
+    }
 }
 
 template <typename... Args>
 void critical(FormatWithLocation fmt, Args &&...args) {
-    get_default_logger()->critical(std::move(fmt), std::forward<Args>(args)...);
+    if constexpr (level::is_active(level::critical)) {
+        details::default_logger_ref()->critical(std::move(fmt), std::forward<Args>(args)...);
+    }
 }
 
 
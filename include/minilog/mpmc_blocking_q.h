@@ -3,6 +3,7 @@
 #include <condition_variable>
 #include <mutex>
 #include <queue>
+#include <vector>
 
 namespace minilog {
 template <typename T>
@@ -72,6 +73,25 @@ public:
         pop_cv_.notify_one();
     }
 
+    // waits for at least one item, then takes up to max_items without waiting,
+    // items are moved into the front of popped_items which is grown as needed
+    size_t dequeue_bulk(std::vector<T>& popped_items, size_t max_items) {
+        if (popped_items.size() < max_items) {
+            popped_items.resize(max_items);
+        }
+        size_t count = 0;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            push_cv_.wait(lock, [this] { return !q_.empty(); });
+            for (; count < max_items && !q_.empty(); ++count) {
+                popped_items[count] = std::move(q_.front());
+                q_.pop();
+            }
+        }
+        pop_cv_.notify_all();
+        return count;
+    }
+
     size_t overrun_counter() {
         return overrun_counter_ .load(std::memory_order_relaxed);
     }
@@ -0,0 +1,194 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <minilog/common.h>
+#include <minilog/parking.h>
+
+namespace minilog {
+
+// bounded lock free queue with per slot sequence numbers (Dmitry Vyukov's design),
+// offers the same interface as mpmc_blocking_queue.
+// consumers spin for a while before parking, producers only wake them when they are parked.
+template <typename T>
+class mpmc_ring_queue {
+public:
+    using item_type = T;
+    explicit mpmc_ring_queue(size_t max_items)
+        : capacity_(std::bit_ceil(std::max<size_t>(max_items, 2))),
+          mask_(capacity_ - 1),
+          buffer_(std::make_unique<cell[]>(capacity_)) {
+        for (size_t i = 0; i < capacity_; ++i) {
+            buffer_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    mpmc_ring_queue(const mpmc_ring_queue &) = delete;
+    mpmc_ring_queue &operator=(const mpmc_ring_queue &) = delete;
+
+    void enqueue(T&& item) {
+        for (unsigned spins = 0; !try_enqueue_(item); ++spins) {
+            if (spins < spin_limit) {
+                std::this_thread::yield();
+            } else {
+                not_full_.park([this, &item] { return try_enqueue_(item); });
+                break;
+            }
+        }
+        not_empty_.wake();
+    }
+
+    void enqueue_nowait(T&& item) {
+        while (!try_enqueue_(item)) {
+            T dropped;
+            if (try_dequeue_(dropped)) {
+                ++overrun_counter_;
+            }
+        }
+        not_empty_.wake();
+    }
+
+    void enqueue_if_have_room(T&& item) {
+        if (try_enqueue_(item)) {
+            not_empty_.wake();
+        } else {
+            ++discard_counter_;
+        }
+    }
+
+    bool dequeue_for(T& popped_item, std::chrono::milliseconds wait_duration) {
+        auto deadline = std::chrono::steady_clock::now() + wait_duration;
+        for (unsigned spins = 0; !try_dequeue_(popped_item); ++spins) {
+            if (std::chrono::steady_clock::now() >= deadline) {
+                return false;
+            }
+            if (spins < spin_limit) {
+                std::this_thread::yield();
+            } else {
+                // atomic waits have no timeout, poll at a coarse interval instead of parking
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+        }
+        not_full_.wake();
+        return true;
+    }
+
+    void dequeue(T& popped_item) {
+        for (unsigned spins = 0; !try_dequeue_(popped_item); ++spins) {
+            if (spins < spin_limit) {
+                std::this_thread::yield();
+            } else {
+                not_empty_.park([this, &popped_item] { return try_dequeue_(popped_item); });
+                break;
+            }
+        }
+        not_full_.wake();
+    }
+
+    // waits for at least one item, then takes up to max_items without waiting,
+    // items are moved into the front of popped_items which is grown as needed
+    size_t dequeue_bulk(std::vector<T>& popped_items, size_t max_items) {
+        if (popped_items.size() < max_items) {
+            popped_items.resize(max_items);
+        }
+        dequeue(popped_items[0]);
+        size_t count = 1;
+        while (count < max_items && try_dequeue_(popped_items[count])) {
+            ++count;
+        }
+        if (count > 1) {
+            not_full_.wake();
+        }
+        return count;
+    }
+
+    size_t overrun_counter() {
+        return overrun_counter_.load(std::memory_order_relaxed);
+    }
+    size_t discard_counter() {
+        return discard_counter_.load(std::memory_order_relaxed);
+    }
+    size_t size() {
+        size_t tail = dequeue_pos_.load(std::memory_order_relaxed);
+        size_t head = enqueue_pos_.load(std::memory_order_relaxed);
+        return head > tail ? std::min(head - tail, capacity_) : 0;
+    }
+    void reset_overrun_counter() {
+        overrun_counter_.store(0, std::memory_order_relaxed);
+    }
+    void reset_discard_counter() {
+        discard_counter_.store(0, std::memory_order_relaxed);
+    }
+private:
+    static constexpr unsigned spin_limit = 64;
+
+    struct alignas(cache_line_size) cell {
+        std::atomic<size_t> sequence;
+        T data;
+    };
+
+    // moves from item only when it succeeds
+    bool try_enqueue_(T& item) {
+        size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+        cell *c;
+        for (;;) {
+            c = &buffer_[pos & mask_];
+            size_t seq = c->sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+        c->data = std::move(item);
+        c->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool try_dequeue_(T& item) {
+        size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+        cell *c;
+        for (;;) {
+            c = &buffer_[pos & mask_];
+            size_t seq = c->sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = dequeue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+        item = std::move(c->data);
+        c->sequence.store(pos + mask_ + 1, std::memory_order_release);
+        return true;
+    }
+
+    const size_t capacity_;
+    const size_t mask_;
+    std::unique_ptr<cell[]> buffer_;
+
+    alignas(cache_line_size) std::atomic<size_t> enqueue_pos_{0};
+    alignas(cache_line_size) std::atomic<size_t> dequeue_pos_{0};
+
+    alignas(cache_line_size) parking_spot not_empty_;
+    alignas(cache_line_size) parking_spot not_full_;
+
+    alignas(cache_line_size) std::atomic<size_t> discard_counter_{0};
+    std::atomic<size_t> overrun_counter_{0};
+};
+}
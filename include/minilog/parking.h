@@ -0,0 +1,39 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+namespace minilog {
+
+// lets a thread sleep until another one reports progress, the waking side
+// only pays for a notify when somebody is actually parked
+class parking_spot {
+public:
+    // announce the waiter, re-check, then sleep until the epoch moves
+    template <typename TryOp>
+    void park(TryOp try_op) {
+        for (;;) {
+            uint32_t observed = epoch_.load(std::memory_order_acquire);
+            parked_.fetch_add(1, std::memory_order_seq_cst);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (try_op()) {
+                parked_.fetch_sub(1, std::memory_order_relaxed);
+                return;
+            }
+            epoch_.wait(observed, std::memory_order_acquire);
+            parked_.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+
+    void wake() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (parked_.load(std::memory_order_relaxed) != 0) {
+            epoch_.fetch_add(1, std::memory_order_release);
+            epoch_.notify_all();
+        }
+    }
+
+private:
+    std::atomic<uint32_t> epoch_{0};
+    std::atomic<uint32_t> parked_{0};
+};
+}
@@ -0,0 +1,311 @@
+#pragma once
+
+#include <charconv>
+#include <chrono>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <magic_enum.hpp>
+
+#include <minilog/common.h>
+#include <minilog/formatter.h>
+#include <minilog/log_msg.h>
+
+namespace minilog {
+namespace details {
+
+inline void append_string_view(std::string_view view, memory_buf_t &dest) {
+    dest.append(view);
+}
+
+inline void append_int(long long n, memory_buf_t &dest) {
+    char buf[24];
+    auto [ptr, ec] = std::to_chars(buf, buf + sizeof(buf), n);
+    dest.append(buf, ptr);
+}
+
+inline void pad_uint(unsigned long long n, size_t width, memory_buf_t &dest) {
+    char buf[24];
+    auto [ptr, ec] = std::to_chars(buf, buf + sizeof(buf), n);
+    for (auto digits = static_cast<size_t>(ptr - buf); digits < width; ++digits) {
+        dest.push_back('0');
+    }
+    dest.append(buf, ptr);
+}
+
+template <typename ToDuration>
+ToDuration time_fraction(log_clock::time_point tp) {
+    auto duration = tp.time_since_epoch();
+    auto secs = std::chrono::floor<std::chrono::seconds>(duration);
+    return std::chrono::duration_cast<ToDuration>(duration - secs);
+}
+
+class flag_formatter {
+public:
+    virtual ~flag_formatter() = default;
+    virtual void format(const log_msg &msg, const std::tm &tm_time, memory_buf_t &dest) = 0;
+};
+
+// %Y
+class year_formatter final : public flag_formatter {
+public:
+    void format(const log_msg &, const std::tm &tm_time, memory_buf_t &dest) override {
+        append_int(tm_time.tm_year + 1900, dest);
+    }
+};
+
+// %m
+class month_formatter final : public flag_formatter {
+public:
+    void format(const log_msg &, const std::tm &tm_time, memory_buf_t &dest) override {
+        pad_uint(static_cast<unsigned>(tm_time.tm_mon + 1), 2, dest);
+    }
+};
+
+// %d
+class day_formatter final : public flag_formatter {
+public:
+    void format(const log_msg &, const std::tm &tm_time, memory_buf_t &dest) override {
+        pad_uint(static_cast<unsigned>(tm_time.tm_mday), 2, dest);
+    }
+};
+
+// %H
+class hour_formatter final : public flag_formatter {
+public:
+    void format(const log_msg &, const std::tm &tm_time, memory_buf_t &dest) override {
+        pad_uint(static_cast<unsigned>(tm_time.tm_hour), 2, dest);
+    }
+};
+
+// %M
+class minute_formatter final : public flag_formatter {
+public:
+    void format(const log_msg &, const std::tm &tm_time, memory_buf_t &dest) override {
+        pad_uint(static_cast<unsigned>(tm_time.tm_min), 2, dest);
+    }
+};
+
+// %S
+class second_formatter final : public flag_formatter {
+public:
+    void format(const log_msg &, const std::tm &tm_time, memory_buf_t &dest) override {
+        pad_uint(static_cast<unsigned>(tm_time.tm_sec), 2, dest);
+    }
+};
+
+// %e %f %F
+template <typename Duration, size_t Width>
+class fraction_formatter final : public flag_formatter {
+public:
+    void format(const log_msg &msg, const std::tm &, memory_buf_t &dest) override {
+        pad_uint(static_cast<unsigned long long>(time_fraction<Duration>(msg.time).count()), Width, dest);
+    }
+};
+
+// %Z
+class zone_formatter final : public flag_formatter {
+public:
+    void format(const log_msg &, const std::tm &tm_time, memory_buf_t &dest) override {
+        if (tm_time.tm_zone) {
+            append_string_view(tm_time.tm_zone, dest);
+        }
+    }
+};
+
+// %l
+class level_formatter final : public flag_formatter {
+public:
+    void format(const log_msg &msg, const std::tm &, memory_buf_t &dest) override {
+        append_string_view(magic_enum::enum_name(msg.level), dest);
+    }
+};
+
+// %L
+class short_level_formatter final : public flag_formatter {
+public:
+    void format(const log_msg &msg, const std::tm &, memory_buf_t &dest) override {
+        static constexpr std::string_view short_names = "TDIWECO";
+        dest.push_back(short_names[msg.level]);
+    }
+};
+
+// %n
+class name_formatter final : public flag_formatter {
+public:
+    void format(const log_msg &msg, const std::tm &, memory_buf_t &dest) override {
+        append_string_view(msg.logger_name, dest);
+    }
+};
+
+// %v
+class payload_formatter final : public flag_formatter {
+public:
+    void format(const log_msg &msg, const std::tm &, memory_buf_t &dest) override {
+        append_string_view(msg.payload, dest);
+    }
+};
+
+// %s
+class source_filename_formatter final : public flag_formatter {
+public:
+    void format(const log_msg &msg, const std::tm &, memory_buf_t &dest) override {
+        std::string_view path = msg.location.file_name();
+        auto slash = path.find_last_of('/');
+        append_string_view(slash == std::string_view::npos ? path : path.substr(slash + 1), dest);
+    }
+};
+
+// %g
+class source_path_formatter final : public flag_formatter {
+public:
+    void format(const log_msg &msg, const std::tm &, memory_buf_t &dest) override {
+        append_string_view(msg.location.file_name(), dest);
+    }
+};
+
+// %#
+class source_line_formatter final : public flag_formatter {
+public:
+    void format(const log_msg &msg, const std::tm &, memory_buf_t &dest) override {
+        append_int(msg.location.line(), dest);
+    }
+};
+
+// %!
+class source_funcname_formatter final : public flag_formatter {
+public:
+    void format(const log_msg &msg, const std::tm &, memory_buf_t &dest) override {
+        append_string_view(msg.location.function_name(), dest);
+    }
+};
+
+// %^
+class color_start_formatter final : public flag_formatter {
+public:
+    void format(const log_msg &msg, const std::tm &, memory_buf_t &dest) override {
+        msg.color_range_start = dest.size();
+    }
+};
+
+// %$
+class color_stop_formatter final : public flag_formatter {
+public:
+    void format(const log_msg &msg, const std::tm &, memory_buf_t &dest) override {
+        msg.color_range_end = dest.size();
+    }
+};
+
+// literal text between flags
+class aggregate_formatter final : public flag_formatter {
+public:
+    explicit aggregate_formatter(std::string text) : text_(std::move(text)) {}
+
+    void format(const log_msg &, const std::tm &, memory_buf_t &dest) override {
+        append_string_view(text_, dest);
+    }
+private:
+    std::string text_;
+};
+} // namespace details
+
+class pattern_formatter final : public formatter {
+public:
+    static constexpr std::string_view default_pattern = "%^%s:%# [%Y-%m-%d %H:%M:%S.%e %Z] [%n] [%l] %v%$";
+
+    explicit pattern_formatter(std::string pattern = std::string(default_pattern), std::string eol = "\n")
+        : pattern_(std::move(pattern)),
+          eol_(std::move(eol)) {
+        compile_pattern_();
+    }
+
+    pattern_formatter(const pattern_formatter &) = delete;
+    pattern_formatter &operator=(const pattern_formatter &) = delete;
+
+    std::unique_ptr<formatter> clone() const override {
+        return std::make_unique<pattern_formatter>(pattern_, eol_);
+    }
+
+    void format(const log_msg &msg, memory_buf_t &dest) override {
+        auto secs = std::chrono::floor<std::chrono::seconds>(msg.time);
+        if (secs != cached_seconds_) {
+            std::time_t t = log_clock::to_time_t(secs);
+            localtime_r(&t, &cached_tm_);
+            cached_seconds_ = secs;
+        }
+        for (auto &f : formatters_) {
+            f->format(msg, cached_tm_, dest);
+        }
+        details::append_string_view(eol_, dest);
+    }
+
+    const std::string &pattern() const {
+        return pattern_;
+    }
+
+private:
+    void compile_pattern_() {
+        std::string literal;
+        auto flush_literal = [&] {
+            if (!literal.empty()) {
+                formatters_.push_back(std::make_unique<details::aggregate_formatter>(std::move(literal)));
+                literal.clear();
+            }
+        };
+
+        for (size_t i = 0; i < pattern_.size(); ++i) {
+            if (pattern_[i] != '%' || i + 1 == pattern_.size()) {
+                literal.push_back(pattern_[i]);
+                continue;
+            }
+            char flag = pattern_[++i];
+            auto flag_formatter = make_flag_formatter_(flag);
+            if (flag_formatter) {
+                flush_literal();
+                formatters_.push_back(std::move(flag_formatter));
+            } else if (flag == '%') {
+                literal.push_back('%');
+            } else {
+                literal.push_back('%');
+                literal.push_back(flag);
+            }
+        }
+        flush_literal();
+    }
+
+    static std::unique_ptr<details::flag_formatter> make_flag_formatter_(char flag) {
+        using namespace std::chrono;
+        switch (flag) {
+        case 'Y': return std::make_unique<details::year_formatter>();
+        case 'm': return std::make_unique<details::month_formatter>();
+        case 'd': return std::make_unique<details::day_formatter>();
+        case 'H': return std::make_unique<details::hour_formatter>();
+        case 'M': return std::make_unique<details::minute_formatter>();
+        case 'S': return std::make_unique<details::second_formatter>();
+        case 'e': return std::make_unique<details::fraction_formatter<milliseconds, 3>>();
+        case 'f': return std::make_unique<details::fraction_formatter<microseconds, 6>>();
+        case 'F': return std::make_unique<details::fraction_formatter<nanoseconds, 9>>();
+        case 'Z': return std::make_unique<details::zone_formatter>();
+        case 'l': return std::make_unique<details::level_formatter>();
+        case 'L': return std::make_unique<details::short_level_formatter>();
+        case 'n': return std::make_unique<details::name_formatter>();
+        case 'v': return std::make_unique<details::payload_formatter>();
+        case 's': return std::make_unique<details::source_filename_formatter>();
+        case 'g': return std::make_unique<details::source_path_formatter>();
+        case '#': return std::make_unique<details::source_line_formatter>();
+        case '!': return std::make_unique<details::source_funcname_formatter>();
+        case '^': return std::make_unique<details::color_start_formatter>();
+        case '$': return std::make_unique<details::color_stop_formatter>();
+        default: return nullptr;
+        }
+    }
+
+    std::string pattern_;
+    std::string eol_;
+    std::vector<std::unique_ptr<details::flag_formatter>> formatters_;
+    std::tm cached_tm_{};
+    std::chrono::sys_seconds cached_seconds_{std::chrono::sys_seconds::min()};
+};
+}
@@ -0,0 +1,292 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <minilog/common.h>
+#include <minilog/parking.h>
+
+namespace minilog {
+
+// wait free single producer single consumer ring
+template <typename T>
+class spsc_ring {
+public:
+    explicit spsc_ring(size_t max_items)
+        : capacity_(std::bit_ceil(std::max<size_t>(max_items, 2))),
+          mask_(capacity_ - 1),
+          slots_(std::make_unique<T[]>(capacity_)) {}
+
+    spsc_ring(const spsc_ring &) = delete;
+    spsc_ring &operator=(const spsc_ring &) = delete;
+
+    // producer side, moves from item only when it succeeds
+    bool try_push(T& item) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_cache_ == capacity_) {
+            head_cache_ = head_.load(std::memory_order_acquire);
+            if (tail - head_cache_ == capacity_) {
+                return false;
+            }
+        }
+        slots_[tail & mask_] = std::move(item);
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer side
+    T* front() {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_cache_) {
+            tail_cache_ = tail_.load(std::memory_order_acquire);
+            if (head == tail_cache_) {
+                return nullptr;
+            }
+        }
+        return &slots_[head & mask_];
+    }
+
+    void pop() {
+        head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    size_t size() const {
+        return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+    }
+
+    // set once the producing thread exited, the consumer drops the ring after draining it
+    std::atomic<bool> abandoned{false};
+    // set once the owning queue is gone, producers drop their handle on the next lookup
+    std::atomic<bool> detached{false};
+
+private:
+    const size_t capacity_;
+    const size_t mask_;
+    std::unique_ptr<T[]> slots_;
+
+    alignas(cache_line_size) std::atomic<size_t> tail_{0};
+    size_t head_cache_{0};
+    alignas(cache_line_size) std::atomic<size_t> head_{0};
+    size_t tail_cache_{0};
+};
+
+// every producer thread lazily gets its own spsc_ring, a single consumer
+// polls all of them and pops the oldest head by timestamp (T::time), so
+// producers never touch a shared cache line on the enqueue path.
+// a producer can't evict the oldest item of a ring it doesn't consume,
+// so overrun_oldest drops the new item and counts it as an overrun.
+template <typename T>
+class per_thread_queue {
+public:
+    using item_type = T;
+    using ring_type = spsc_ring<T>;
+
+    explicit per_thread_queue(size_t max_items_per_thread)
+        : max_items_per_thread_(max_items_per_thread) {}
+
+    per_thread_queue(const per_thread_queue &) = delete;
+    per_thread_queue &operator=(const per_thread_queue &) = delete;
+
+    ~per_thread_queue() {
+        std::lock_guard<std::mutex> lock(rings_mutex_);
+        for (auto &ring : rings_) {
+            ring->detached.store(true, std::memory_order_release);
+        }
+    }
+
+    void enqueue(T&& item) {
+        auto &ring = local_ring_();
+        for (unsigned spins = 0; !ring.try_push(item); ++spins) {
+            if (spins < spin_limit) {
+                std::this_thread::yield();
+            } else {
+                not_full_.park([&ring, &item] { return ring.try_push(item); });
+                break;
+            }
+        }
+        not_empty_.wake();
+    }
+
+    void enqueue_nowait(T&& item) {
+        if (local_ring_().try_push(item)) {
+            not_empty_.wake();
+        } else {
+            ++overrun_counter_;
+        }
+    }
+
+    void enqueue_if_have_room(T&& item) {
+        if (local_ring_().try_push(item)) {
+            not_empty_.wake();
+        } else {
+            ++discard_counter_;
+        }
+    }
+
+    bool dequeue_for(T& popped_item, std::chrono::milliseconds wait_duration) {
+        auto deadline = std::chrono::steady_clock::now() + wait_duration;
+        for (unsigned spins = 0; !try_dequeue_(popped_item); ++spins) {
+            if (std::chrono::steady_clock::now() >= deadline) {
+                return false;
+            }
+            if (spins < spin_limit) {
+                std::this_thread::yield();
+            } else {
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+        }
+        not_full_.wake();
+        return true;
+    }
+
+    void dequeue(T& popped_item) {
+        for (unsigned spins = 0; !try_dequeue_(popped_item); ++spins) {
+            if (spins < spin_limit) {
+                std::this_thread::yield();
+            } else {
+                not_empty_.park([this, &popped_item] { return try_dequeue_(popped_item); });
+                break;
+            }
+        }
+        not_full_.wake();
+    }
+
+    // waits for at least one item, then takes up to max_items without waiting,
+    // items are moved into the front of popped_items which is grown as needed
+    size_t dequeue_bulk(std::vector<T>& popped_items, size_t max_items) {
+        if (popped_items.size() < max_items) {
+            popped_items.resize(max_items);
+        }
+        dequeue(popped_items[0]);
+        size_t count = 1;
+        while (count < max_items && try_dequeue_(popped_items[count])) {
+            ++count;
+        }
+        if (count > 1) {
+            not_full_.wake();
+        }
+        return count;
+    }
+
+    size_t overrun_counter() {
+        return overrun_counter_.load(std::memory_order_relaxed);
+    }
+    size_t discard_counter() {
+        return discard_counter_.load(std::memory_order_relaxed);
+    }
+    size_t size() {
+        std::lock_guard<std::mutex> lock(rings_mutex_);
+        size_t total = 0;
+        for (auto &ring : rings_) {
+            total += ring->size();
+        }
+        return total;
+    }
+    void reset_overrun_counter() {
+        overrun_counter_.store(0, std::memory_order_relaxed);
+    }
+    void reset_discard_counter() {
+        discard_counter_.store(0, std::memory_order_relaxed);
+    }
+private:
+    static constexpr unsigned spin_limit = 64;
+
+    struct local_rings {
+        std::vector<std::pair<uint64_t, std::shared_ptr<ring_type>>> entries;
+        ~local_rings() {
+            for (auto &entry : entries) {
+                entry.second->abandoned.store(true, std::memory_order_release);
+            }
+        }
+    };
+
+    static uint64_t next_queue_id_() {
+        static std::atomic<uint64_t> id{0};
+        return ++id;
+    }
+
+    ring_type& local_ring_() {
+        thread_local local_rings local;
+        for (auto &[id, ring] : local.entries) {
+            if (id == id_) {
+                return *ring;
+            }
+        }
+        std::erase_if(local.entries, [](const auto &entry) {
+            return entry.second->detached.load(std::memory_order_acquire);
+        });
+        auto ring = std::make_shared<ring_type>(max_items_per_thread_);
+        {
+            std::lock_guard<std::mutex> lock(rings_mutex_);
+            rings_.push_back(ring);
+            rings_generation_.fetch_add(1, std::memory_order_release);
+        }
+        local.entries.emplace_back(id_, ring);
+        return *ring;
+    }
+
+    // consumer only
+    bool try_dequeue_(T& item) {
+        auto generation = rings_generation_.load(std::memory_order_acquire);
+        if (generation != consumer_generation_) {
+            std::lock_guard<std::mutex> lock(rings_mutex_);
+            consumer_rings_ = rings_;
+            consumer_generation_ = rings_generation_.load(std::memory_order_relaxed);
+        }
+
+        ring_type *oldest_ring = nullptr;
+        T *oldest = nullptr;
+        bool has_abandoned = false;
+        for (auto &ring : consumer_rings_) {
+            T *head = ring->front();
+            if (head == nullptr) {
+                has_abandoned |= ring->abandoned.load(std::memory_order_acquire);
+            } else if (oldest == nullptr || head->time < oldest->time) {
+                oldest_ring = ring.get();
+                oldest = head;
+            }
+        }
+
+        if (oldest == nullptr) {
+            if (has_abandoned) {
+                drop_abandoned_rings_();
+            }
+            return false;
+        }
+        item = std::move(*oldest);
+        oldest_ring->pop();
+        return true;
+    }
+
+    void drop_abandoned_rings_() {
+        std::lock_guard<std::mutex> lock(rings_mutex_);
+        std::erase_if(rings_, [](const auto &ring) {
+            return ring->abandoned.load(std::memory_order_acquire) && ring->size() == 0;
+        });
+        rings_generation_.fetch_add(1, std::memory_order_release);
+    }
+
+    const uint64_t id_{next_queue_id_()};
+    const size_t max_items_per_thread_;
+
+    std::mutex rings_mutex_;
+    std::vector<std::shared_ptr<ring_type>> rings_;
+    std::atomic<uint64_t> rings_generation_{0};
+
+    std::vector<std::shared_ptr<ring_type>> consumer_rings_;
+    uint64_t consumer_generation_{0};
+
+    alignas(cache_line_size) parking_spot not_empty_;
+    alignas(cache_line_size) parking_spot not_full_;
+
+    alignas(cache_line_size) std::atomic<size_t> discard_counter_{0};
+    std::atomic<size_t> overrun_counter_{0};
+};
+}
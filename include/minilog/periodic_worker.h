@@ -0,0 +1,75 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+namespace minilog {
+
+// runs a callback every interval on its own thread until destroyed. the destructor
+// wakes the thread right away instead of waiting out the interval
+class periodic_worker {
+public:
+    template <typename Rep, typename Period>
+    periodic_worker(std::function<void()> callback, std::chrono::duration<Rep, Period> interval)
+        : thread_([this, callback = std::move(callback), interval = checked_interval_(interval)](std::stop_token stop) {
+              run_(stop, callback, interval);
+          }) {}
+
+    ~periodic_worker() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            thread_.request_stop();
+        }
+        cv_.notify_all();
+    }
+
+    periodic_worker(const periodic_worker &) = delete;
+    periodic_worker &operator=(const periodic_worker &) = delete;
+
+private:
+    std::mutex mutex_;
+    std::condition_variable_any cv_;
+    // declared last so the members above outlive the thread
+    std::jthread thread_;
+
+    // throws before the thread starts, so a bad interval never runs the callback
+    template <typename Rep, typename Period>
+    static std::chrono::steady_clock::duration checked_interval_(std::chrono::duration<Rep, Period> interval) {
+        auto converted = std::chrono::duration_cast<std::chrono::steady_clock::duration>(interval);
+        if (interval <= std::chrono::duration<Rep, Period>::zero() || converted <= std::chrono::steady_clock::duration::zero()) {
+            throw std::runtime_error("periodic_worker: interval must be positive");
+        }
+        return converted;
+    }
+
+    void run_(std::stop_token stop, const std::function<void()> &callback, std::chrono::steady_clock::duration interval) {
+        auto next = std::chrono::steady_clock::now() + interval;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                if (cv_.wait_until(lock, stop, next, [] { return false; }) || stop.stop_requested()) {
+                    return;
+                }
+            }
+            try {
+                callback();
+            } catch (const std::exception &ex) {
+                std::fprintf(stderr, "minilog periodic task failed: %s\n", ex.what());
+            }
+            // a slow callback skips the ticks it overran instead of running back to back
+            auto now = std::chrono::steady_clock::now();
+            next += interval;
+            if (next <= now) {
+                next = now + interval;
+            }
+        }
+    }
+};
+
+}
@@ -1,13 +1,28 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iterator>
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <shared_mutex>
+#include <vector>
 
+#include <minilog/hazard_pointer.h>
+#include <minilog/log_switch.h>
 #include <minilog/logger.h>
+#include <minilog/periodic_worker.h>
 #include <minilog/sinks/ansicolor_sink.h>
 namespace minilog {
 class thread_pool;
+class logger_handle;
+namespace details {
+class logger_ref;
+logger_ref default_logger_ref();
+}
 class registry {
 public:
     static registry& get_instance()
@@ -24,12 +39,21 @@ public:
         if (loggers_.find(logger_name) != loggers_.end()) {
             throw std::runtime_error(std::format("register a registerd logger: {}", logger_name));
         }
+        apply_levels_(*new_logger);
         loggers_[logger_name] = std::move(new_logger);
+        bump_generation_();
     }
 
     void drop_logger(const std::string &logger_name) {
         std::unique_lock lock(logger_map_mutex_);
         loggers_.erase(logger_name);
+        bump_generation_();
+    }
+
+    // changes whenever a name may resolve to a different logger, lookups cached by
+    // minilog::get and logger_handle stay valid as long as it doesn't
+    uint64_t generation() const noexcept {
+        return generation_.load(std::memory_order_acquire);
     }
 
     std::shared_ptr<logger> get(const std::string &logger_name) {
@@ -40,18 +64,55 @@ public:
 
     std::shared_ptr<logger> get_default_logger() const {
         std::shared_lock lock(logger_map_mutex_);
-        return default_logger_name_ ? loggers_.at(default_logger_name_.value()) : nullptr;
+        return default_logger_;
+    }
+
+    // never null. only valid until set_default_logger replaces it, the free logging
+    // functions hold it through a details::logger_ref instead
+    logger *default_logger_raw() const noexcept {
+        return default_logger_raw_.load(std::memory_order_acquire);
     }
 
+    // the replaced default is flushed and dropped as soon as no thread is inside a free
+    // logging function with it, otherwise at a later set_default_logger or flush_all.
+    // what its flush throws is rethrown once it is retired
     void set_default_logger(std::shared_ptr<logger> new_default_logger) {
-        std::unique_lock lock(logger_map_mutex_);
-        if (new_default_logger) {
-            if (default_logger_name_) {
-                loggers_.erase(default_logger_name_.value());
-                default_logger_name_ = std::nullopt;
+        if (!new_default_logger) {
+            return;
+        }
+        std::shared_ptr<logger> replaced;
+        {
+            std::unique_lock lock(logger_map_mutex_);
+            auto found = loggers_.find(default_logger_->name());
+            if (found != loggers_.end() && found->second == default_logger_) {
+                loggers_.erase(found);
             }
+            apply_levels_(*new_default_logger);
+            replaced = std::move(default_logger_);
             loggers_[new_default_logger->name()] = new_default_logger;
-            default_logger_name_ = new_default_logger->name();
+            default_logger_ = std::move(new_default_logger);
+            default_logger_raw_.store(default_logger_.get(), std::memory_order_release);
+            bump_generation_();
+        }
+        // retired either way, destroying it while unwinding would pull it from under
+        // the threads still logging through it
+        try {
+            replaced->flush();
+        } catch (...) {
+            retire_(std::move(replaced));
+            throw;
+        }
+        retire_(std::move(replaced));
+    }
+
+    // sets the levels of the registered loggers and log_switches the spec names, the
+    // default level goes to every other logger. loggers registered later get them too
+    void set_levels(level_spec spec) {
+        details::switch_directory::instance().apply(spec);
+        std::unique_lock lock(logger_map_mutex_);
+        level_spec_ = std::move(spec);
+        for (auto &[name, l] : loggers_) {
+            apply_levels_(*l);
         }
     }
 
@@ -68,17 +129,148 @@ public:
     std::recursive_mutex& tp_mutex() {
         return tp_mutex_;
     }
+
+    // flushes outside the map lock, a slow sink doesn't hold up get() or register_logger()
+    void flush_all() {
+        std::vector<std::shared_ptr<logger>> loggers;
+        {
+            std::shared_lock lock(logger_map_mutex_);
+            loggers.reserve(loggers_.size());
+            for (auto &[name, l] : loggers_) {
+                loggers.push_back(l);
+            }
+        }
+        for (auto &l : loggers) {
+            l->flush();
+        }
+        retire_(nullptr);
+    }
+
+    // one thread flushing every registered logger each interval, async loggers only get a
+    // flush message posted. calling it again replaces the interval
+    template <typename Rep, typename Period>
+    void flush_every(std::chrono::duration<Rep, Period> interval) {
+        std::lock_guard<std::mutex> lock(flusher_mutex_);
+        periodic_flusher_.reset();
+        periodic_flusher_ = std::make_unique<periodic_worker>([this] { flush_all(); }, interval);
+    }
+
+    void stop_flush_every() {
+        std::lock_guard<std::mutex> lock(flusher_mutex_);
+        periodic_flusher_.reset();
+    }
 private:
+    friend class logger_handle;
+    friend details::logger_ref details::default_logger_ref();
+
     registry() {
-        default_logger_name_ = "";
         auto color_sink = std::make_shared<sinks::ansicolor_stdout_sink_mt>();
-        auto default_logger = std::make_shared<logger>(default_logger_name_.value(), std::move(color_sink));
-        loggers_[default_logger_name_.value()] = std::move(default_logger);
+        default_logger_ = std::make_shared<logger>("", std::move(color_sink));
+        loggers_[default_logger_->name()] = default_logger_;
+        default_logger_raw_.store(default_logger_.get(), std::memory_order_release);
+    }
+    // called with logger_map_mutex_ held
+    void apply_levels_(logger &l) const {
+        auto found = level_spec_.levels.find(l.name());
+        if (found != level_spec_.levels.end()) {
+            l.set_level(found->second);
+        } else if (level_spec_.default_level) {
+            l.set_level(*level_spec_.default_level);
+        }
     }
+
+    // takes a logger that was just unpublished from a pointer read through a logger_ref,
+    // then drops every retired logger no thread holds a hazard pointer to. a thread that
+    // loaded one before it was unpublished holds it only until its ref goes out of scope
+    void retire_(std::shared_ptr<logger> unpublished) {
+        std::vector<std::shared_ptr<logger>> unused;
+        {
+            std::lock_guard<std::mutex> lock(retired_mutex_);
+            if (unpublished) {
+                retired_loggers_.push_back(std::move(unpublished));
+            }
+            if (retired_loggers_.empty()) {
+                return;
+            }
+            auto &domain = details::hazard_domain::instance();
+            domain.fence();
+            auto still_used = std::partition(retired_loggers_.begin(), retired_loggers_.end(),
+                                             [&domain](const auto &l) { return domain.in_use(l.get()); });
+            std::move(still_used, retired_loggers_.end(), std::back_inserter(unused));
+            retired_loggers_.erase(still_used, retired_loggers_.end());
+        }
+        // destroyed here, outside the lock, an async logger waits for its queued records
+        unused.clear();
+    }
+
+    // called with logger_map_mutex_ held, after the map has changed
+    void bump_generation_() {
+        generation_.fetch_add(1, std::memory_order_release);
+    }
+
     mutable std::shared_mutex logger_map_mutex_;
     mutable std::recursive_mutex tp_mutex_;
     std::shared_ptr<thread_pool> tp_;
     std::unordered_map<std::string, std::shared_ptr<logger>> loggers_;
-    std::optional<std::string> default_logger_name_;
+    std::shared_ptr<logger> default_logger_;
+    std::atomic<logger *> default_logger_raw_{nullptr};
+    std::mutex retired_mutex_;
+    // replaced defaults and logger_handle targets another thread was still using
+    std::vector<std::shared_ptr<logger>> retired_loggers_;
+    std::atomic<uint64_t> generation_{0};
+    level_spec level_spec_;
+    std::mutex flusher_mutex_;
+    // declared last, the flusher thread stops before the loggers go away
+    std::unique_ptr<periodic_worker> periodic_flusher_;
+};
+
+namespace details {
+// a logger published as a hazard pointer, so whoever replaces the pointer it was loaded
+// from can't free it while the ref is in scope. falls back to a shared_ptr copy when
+// protected calls nest too deep
+class logger_ref {
+public:
+    // fallback returns a shared_ptr to what source points at
+    template <typename Fallback>
+    logger_ref(const std::atomic<logger *> &source, Fallback &&fallback) {
+        logger_ = hazard_domain::instance().protect(source, slot_);
+        if (slot_ == nullptr) [[unlikely]] {
+            owner_ = fallback();
+            logger_ = owner_.get();
+        }
+    }
+
+    ~logger_ref() {
+        if (slot_ != nullptr) {
+            hazard_domain::release(slot_);
+        }
+    }
+
+    logger_ref(const logger_ref &) = delete;
+    logger_ref &operator=(const logger_ref &) = delete;
+
+    logger *get() const noexcept {
+        return logger_;
+    }
+
+    logger *operator->() const noexcept {
+        return logger_;
+    }
+
+    explicit operator bool() const noexcept {
+        return logger_ != nullptr;
+    }
+
+private:
+    hazard_domain::thread_slot *slot_{nullptr};
+    logger *logger_;
+    std::shared_ptr<logger> owner_;
 };
-}
\ No newline at end of file
+
+// what the free logging functions log through
+inline logger_ref default_logger_ref() {
+    auto &registry_inst = registry::get_instance();
+    return logger_ref(registry_inst.default_logger_raw_, [&registry_inst] { return registry_inst.get_default_logger(); });
+}
+}
+}
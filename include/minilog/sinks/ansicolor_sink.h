@@ -3,16 +3,15 @@
 #include <array>
 #include <cstdio>
 #include <cstdlib>
-#include <filesystem>
-#include <magic_enum.hpp>
 #include <unistd.h>
 #include <string>
 #include <algorithm>
-#include <format>
+#include <span>
 
 #include <minilog/sinks/sink.h>
 #include <minilog/common.h>
 #include <minilog/null_mutex.h>
+#include <minilog/pattern_formatter.h>
 namespace minilog::sinks {
 
 inline bool in_terminal(FILE *file) {
@@ -57,7 +56,8 @@ public:
     using mutex_t = typename ConsoleMutex::mutex_t;
     ansicolor_sink(FILE *target_file, color_mode mode)
         : target_file_(target_file),
-          mutex_(ConsoleMutex::mutex())
+          mutex_(ConsoleMutex::mutex()),
+          formatter_(std::make_unique<pattern_formatter>())
     {
         set_color_mode(mode);
         colors_.at(level::trace) = white;
@@ -97,11 +97,47 @@ public:
         return should_do_colors_;
     }
 
+    // left in the stdio buffer, written out by flush(), flush_on() or registry::flush_every()
     void log(const log_msg &msg) override {
         std::lock_guard<mutex_t> lock(mutex_);
-        std::string formatted = format(msg);
-        fwrite(formatted.data(), sizeof(char), formatted.size(), target_file_);
-        fflush(target_file_);
+        msg.color_range_start = 0;
+        msg.color_range_end = 0;
+        formatted_.clear();
+        formatter_->format(msg, formatted_);
+        if (should_color() && msg.color_range_end > msg.color_range_start) {
+            print_range_(formatted_, 0, msg.color_range_start);
+            print_ccode_(colors_.at(msg.level));
+            print_range_(formatted_, msg.color_range_start, msg.color_range_end);
+            print_ccode_(reset);
+            print_range_(formatted_, msg.color_range_end, formatted_.size());
+        } else {
+            print_range_(formatted_, 0, formatted_.size());
+        }
+    }
+
+    // colors every line into one buffer and writes it at once
+    void log_batch(std::span<const log_msg> msgs) override {
+        std::lock_guard<mutex_t> lock(mutex_);
+        batch_.clear();
+        for (const auto &msg : msgs) {
+            if (!should_log(msg.level)) {
+                continue;
+            }
+            msg.color_range_start = 0;
+            msg.color_range_end = 0;
+            formatted_.clear();
+            formatter_->format(msg, formatted_);
+            if (should_color() && msg.color_range_end > msg.color_range_start) {
+                batch_.append(formatted_.data(), formatted_.data() + msg.color_range_start);
+                batch_.append(colors_.at(msg.level));
+                batch_.append(formatted_.data() + msg.color_range_start, formatted_.data() + msg.color_range_end);
+                batch_.append(reset);
+                batch_.append(formatted_.data() + msg.color_range_end, formatted_.end());
+            } else {
+                batch_.append(formatted_.begin(), formatted_.end());
+            }
+        }
+        print_range_(batch_, 0, batch_.size());
     }
 
     void flush() override {
@@ -109,16 +145,16 @@ public:
         fflush(target_file_);
     }
 
-    std::string format(const log_msg &msg) {
-        std::filesystem::path absolute_path = msg.location.file_name();
-        std::string format_str = "{}:{} [{}] [{}] [{}] {}";
-        if (should_color()) {
-            format_str = colors_.at(msg.level) + format_str + std::string(reset) + "\n";
-        } else {
-            format_str = format_str + "\n";
-        }
-        return std::vformat(format_str, std::make_format_args(std::string(absolute_path.filename()), msg.location.line(), msg.time, msg.logger_name, magic_enum::enum_name(msg.level), msg.payload));
+    void set_pattern(const std::string &pattern) final {
+        std::lock_guard<mutex_t> lock(mutex_);
+        formatter_ = std::make_unique<pattern_formatter>(pattern);
     }
+
+    void set_formatter(std::unique_ptr<minilog::formatter> sink_formatter) final {
+        std::lock_guard<mutex_t> lock(mutex_);
+        formatter_ = std::move(sink_formatter);
+    }
+
     // Formatting codes
     const std::string_view reset = "\033[m";
     const std::string_view bold = "\033[1m";
@@ -155,10 +191,21 @@ public:
     const std::string_view bold_on_red = "\033[1m\033[41m";
 
 private:
+    void print_ccode_(std::string_view color_code) {
+        fwrite(color_code.data(), sizeof(char), color_code.size(), target_file_);
+    }
+
+    void print_range_(const memory_buf_t &formatted, size_t start, size_t end) {
+        fwrite(formatted.data() + start, sizeof(char), end - start, target_file_);
+    }
+
     FILE *target_file_;
     mutex_t &mutex_;
     bool should_do_colors_;
     std::array<std::string, level::n_levels> colors_;
+    std::unique_ptr<minilog::formatter> formatter_;
+    memory_buf_t formatted_;
+    memory_buf_t batch_;
 };
 
 template <typename ConsoleMutex>
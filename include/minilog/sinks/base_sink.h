@@ -1,18 +1,18 @@
 #pragma once
 
-#include <format>
-#include <filesystem>
+#include <memory>
 
-#include <magic_enum.hpp>
 #include <minilog/common.h>
 #include <minilog/sinks/sink.h>
 #include <minilog/log_msg.h>
+#include <minilog/pattern_formatter.h>
 
 namespace minilog::sinks {
 template <typename Mutex>
 class base_sink : public sink {
 public:
-    base_sink() = default;
+    base_sink() : formatter_(std::make_unique<pattern_formatter>()) {}
+    explicit base_sink(std::unique_ptr<minilog::formatter> formatter) : formatter_(std::move(formatter)) {}
     ~base_sink() override = default;
 
     base_sink(const base_sink &) = delete;
@@ -26,19 +26,54 @@ public:
         sink_it_(msg);
     }
 
+    void log_batch(std::span<const log_msg> msgs) final {
+        std::lock_guard<Mutex> lock(mutex_);
+        sink_batch_(msgs);
+    }
+
     void flush() final {
         std::lock_guard<Mutex> lock(mutex_);
         flush_();
     }
 
-    std::string format(const log_msg &msg) {
-        std::filesystem::path absolute_path = msg.location.file_name();
-        return std::format("{}:{} [{}] [{}] [{}] {}\n", std::string(absolute_path.filename()), msg.location.line(), msg.time, msg.logger_name, magic_enum::enum_name(msg.level), msg.payload);
-    } 
+    void set_pattern(const std::string &pattern) final {
+        std::lock_guard<Mutex> lock(mutex_);
+        set_pattern_(pattern);
+    }
+
+    void set_formatter(std::unique_ptr<minilog::formatter> sink_formatter) final {
+        std::lock_guard<Mutex> lock(mutex_);
+        set_formatter_(std::move(sink_formatter));
+    }
 protected:
     Mutex mutex_;
+    std::unique_ptr<minilog::formatter> formatter_;
+    memory_buf_t formatted_;
 
     virtual void sink_it_(const log_msg &msg) = 0;
     virtual void flush_() = 0;
+
+    virtual void sink_batch_(std::span<const log_msg> msgs) {
+        for (const auto &msg : msgs) {
+            if (should_log(msg.level)) {
+                sink_it_(msg);
+            }
+        }
+    }
+
+    virtual void set_pattern_(const std::string &pattern) {
+        set_formatter_(std::make_unique<pattern_formatter>(pattern));
+    }
+
+    virtual void set_formatter_(std::unique_ptr<minilog::formatter> sink_formatter) {
+        formatter_ = std::move(sink_formatter);
+    }
+
+    // formats into a buffer reused across messages, the caller holds mutex_
+    const memory_buf_t &format_(const log_msg &msg) {
+        formatted_.clear();
+        formatter_->format(msg, formatted_);
+        return formatted_;
+    }
 };
-}
\ No newline at end of file
+}
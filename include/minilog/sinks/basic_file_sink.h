@@ -1,4 +1,4 @@
-#pragma
+#pragma once
 
 #include <mutex>
 #include <memory>
@@ -14,7 +14,8 @@ namespace sinks {
 template <typename Mutex>
 class basic_file_sink final : public base_sink<Mutex> {
 public:
-    explicit basic_file_sink(const std::string &filename) : file_helper_(filename) {}
+    explicit basic_file_sink(const std::string &filename, bool truncate = true, file_options options = {})
+        : file_helper_(filename, truncate, options) {}
 
     const std::string &filename() const {
         return file_helper_.filename();
@@ -22,12 +23,28 @@ public:
 
 protected:
     void sink_it_(const log_msg &msg) override {
-        std::string formatted = base_sink<Mutex>::format(msg);
-        file_helper_.write(formatted);
+        file_helper_.write(this->format_(msg));
     }
 
-    void flush_() override {
+    // one write for the whole batch
+    void sink_batch_(std::span<const log_msg> msgs) override {
+        this->formatted_.clear();
+        for (const auto &msg : msgs) {
+            if (this->should_log(msg.level)) {
+                this->formatter_->format(msg, this->formatted_);
+            }
+        }
+        file_helper_.write(this->formatted_);
+        file_helper_.submit();
+    }
 
+    // hands the buffer to the kernel, with sync_on_flush also waits for the device
+    void flush_() override {
+        if (file_helper_.options().sync_on_flush) {
+            file_helper_.sync();
+        } else {
+            file_helper_.flush();
+        }
     }
 private:
     file_helper file_helper_;
@@ -39,15 +56,19 @@ using basic_file_sink_st = basic_file_sink<null_mutex>;
 
 template <typename Factory = synchronous_factory>
 std::shared_ptr<logger> basic_logger_mt(const std::string &logger_name,
-                                        const std::string &filename)
+                                        const std::string &filename,
+                                        bool truncate = true,
+                                        file_options options = {})
 {
-    return Factory::template create<sinks::basic_file_sink_mt>(logger_name, filename);
+    return Factory::template create<sinks::basic_file_sink_mt>(logger_name, filename, truncate, options);
 }
 
 template <typename Factory = synchronous_factory>
 std::shared_ptr<logger> basic_logger_st(const std::string &logger_name,
-                                        const std::string &filename)
+                                        const std::string &filename,
+                                        bool truncate = true,
+                                        file_options options = {})
 {
-    return Factory::template create<sinks::basic_file_sink_st>(logger_name, filename);
+    return Factory::template create<sinks::basic_file_sink_st>(logger_name, filename, truncate, options);
 }
 }
\ No newline at end of file
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include <minilog/binary_format.h>
+#include <minilog/file_helper.h>
+#include <minilog/null_mutex.h>
+#include <minilog/sinks/base_sink.h>
+#include <minilog/synchronous_factory.h>
+
+namespace minilog {
+namespace sinks {
+
+// writes the compact format described in binary_format.h, the static parts of
+// a call site go out once and every record only carries a time delta and the
+// arguments. messages whose arguments are all deferrable_arg keep them raw, from any
+// logger, the rest is stored as its formatted payload. decode with minilog-decode.
+template <typename Mutex>
+class binary_file_sink final : public base_sink<Mutex> {
+public:
+    explicit binary_file_sink(const std::string &filename) : file_helper_(filename) {}
+
+    const std::string &filename() const {
+        return file_helper_.filename();
+    }
+
+    bool wants_format_args() const override {
+        return true;
+    }
+
+protected:
+    void sink_it_(const log_msg &msg) override {
+        record_.clear();
+        auto time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(msg.time.time_since_epoch()).count();
+        if (!header_written_) {
+            record_.append(binary::magic);
+            auto bytes = std::bit_cast<std::array<char, sizeof(time_ns)>>(time_ns);
+            record_.append(bytes.data(), bytes.data() + bytes.size());
+            last_time_ns_ = time_ns;
+            header_written_ = true;
+        }
+
+        bool raw_args = msg.format_fn != nullptr && !binary::has_opaque_args(msg.format_args);
+        std::string_view format = raw_args ? msg.format_string : std::string_view("{}");
+        uint32_t site_id = site_id_(msg, format);
+
+        record_.push_back(static_cast<char>(binary::record_kind::log));
+        binary::write_varint(site_id, record_);
+        binary::write_varint(binary::zigzag(time_ns - last_time_ns_), record_);
+        last_time_ns_ = time_ns;
+        if (raw_args) {
+            binary::write_varint(msg.format_args.size(), record_);
+            record_.append(msg.format_args);
+        } else {
+            args_.clear();
+            encode_arg(msg.payload, args_);
+            binary::write_varint(args_.size(), record_);
+            record_.append(args_.view());
+        }
+        file_helper_.write(record_);
+    }
+
+    void flush_() override {
+        file_helper_.flush();
+    }
+
+private:
+    // what makes a call site, the file name comes from std::source_location and is static
+    struct site_view {
+        std::string_view format;
+        std::string_view logger_name;
+        std::string_view file_name;
+        uint32_t line;
+        uint32_t column;
+        level::level_enum level;
+
+        bool operator==(const site_view &) const = default;
+    };
+
+    // format and logger name may live in a queue record, the key keeps its own copies
+    struct site_key {
+        std::string format;
+        std::string logger_name;
+        std::string_view file_name;
+        uint32_t line;
+        uint32_t column;
+        level::level_enum level;
+
+        site_view view() const {
+            return {format, logger_name, file_name, line, column, level};
+        }
+    };
+
+    // transparent, a lookup with a site_view doesn't allocate
+    struct site_hash {
+        using is_transparent = void;
+        size_t operator()(const site_view &site) const {
+            size_t h = std::hash<std::string_view>{}(site.format);
+            h = h * 31 + std::hash<std::string_view>{}(site.logger_name);
+            h = h * 31 + std::hash<std::string_view>{}(site.file_name);
+            h = h * 31 + site.line;
+            h = h * 31 + site.column;
+            return h * 31 + static_cast<size_t>(site.level);
+        }
+        size_t operator()(const site_key &site) const {
+            return (*this)(site.view());
+        }
+    };
+
+    struct site_equal {
+        using is_transparent = void;
+        bool operator()(const site_key &a, const site_key &b) const { return a.view() == b.view(); }
+        bool operator()(const site_view &a, const site_key &b) const { return a == b.view(); }
+        bool operator()(const site_key &a, const site_view &b) const { return a.view() == b; }
+    };
+
+    // assigns ids to call sites and emits the site record the first time one is seen
+    uint32_t site_id_(const log_msg &msg, std::string_view format) {
+        site_view site{format, msg.logger_name, msg.location.file_name(), msg.location.line(),
+                       msg.location.column(), msg.level};
+        auto found = site_ids_.find(site);
+        if (found != site_ids_.end()) {
+            return found->second;
+        }
+
+        auto id = static_cast<uint32_t>(site_ids_.size());
+        site_ids_.emplace(site_key{std::string(format), std::string(msg.logger_name), site.file_name,
+                                   site.line, site.column, site.level}, id);
+        record_.push_back(static_cast<char>(binary::record_kind::site));
+        binary::write_varint(id, record_);
+        record_.push_back(static_cast<char>(msg.level));
+        binary::write_varint(msg.location.line(), record_);
+        binary::write_string(msg.location.file_name(), record_);
+        binary::write_string(msg.logger_name, record_);
+        binary::write_string(format, record_);
+        return id;
+    }
+
+    file_helper file_helper_;
+    memory_buf_t record_;
+    memory_buf_t args_;
+    std::unordered_map<site_key, uint32_t, site_hash, site_equal> site_ids_;
+    int64_t last_time_ns_{0};
+    bool header_written_{false};
+};
+
+using binary_file_sink_mt = binary_file_sink<std::mutex>;
+using binary_file_sink_st = binary_file_sink<null_mutex>;
+} // end of namespace sinks
+
+template <typename Factory = synchronous_factory>
+std::shared_ptr<logger> binary_logger_mt(const std::string &logger_name,
+                                         const std::string &filename)
+{
+    return Factory::template create<sinks::binary_file_sink_mt>(logger_name, filename);
+}
+
+template <typename Factory = synchronous_factory>
+std::shared_ptr<logger> binary_logger_st(const std::string &logger_name,
+                                         const std::string &filename)
+{
+    return Factory::template create<sinks::binary_file_sink_st>(logger_name, filename);
+}
+}
@@ -0,0 +1,316 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <deque>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <mutex>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+
+#include <minilog/background_worker.h>
+#include <minilog/file_helper.h>
+#include <minilog/null_mutex.h>
+#include <minilog/sinks/base_sink.h>
+#include <minilog/synchronous_factory.h>
+
+namespace minilog {
+namespace details {
+inline std::tm local_tm(log_clock::time_point tp) {
+    std::time_t t = log_clock::to_time_t(tp);
+    std::tm tm{};
+    localtime_r(&t, &tm);
+    return tm;
+}
+
+// normalizes out of range fields, lets mktime work out dst for the new date
+inline log_clock::time_point make_local_time(std::tm tm) {
+    tm.tm_isdst = -1;
+    return log_clock::from_time_t(std::mktime(&tm));
+}
+}
+
+namespace sinks {
+
+// new file every day at hour:minute local time, logs/app.txt -> logs/app_2024-05-01.txt
+struct daily_rotation {
+    int rotation_hour{0};
+    int rotation_minute{0};
+
+    void validate() const {
+        if (rotation_hour < 0 || rotation_hour > 23 || rotation_minute < 0 || rotation_minute > 59) {
+            throw std::runtime_error("daily_file_sink: invalid rotation time in ctor");
+        }
+    }
+
+    static std::string calc_filename(const std::string &filename, const std::tm &tm) {
+        auto [basename, ext] = file_helper::split_by_extension(filename);
+        return std::format("{}_{:04}-{:02}-{:02}{}", basename, tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, ext);
+    }
+
+    log_clock::time_point next_rotation(log_clock::time_point now) const {
+        std::tm tm = details::local_tm(now);
+        tm.tm_hour = rotation_hour;
+        tm.tm_min = rotation_minute;
+        tm.tm_sec = 0;
+        auto rotation_time = details::make_local_time(tm);
+        if (rotation_time > now) {
+            return rotation_time;
+        }
+        tm.tm_mday += 1;
+        return details::make_local_time(tm);
+    }
+
+    // the start of the period that many periods before now
+    static log_clock::time_point previous(log_clock::time_point now, int periods) {
+        std::tm tm = details::local_tm(now);
+        tm.tm_mday -= periods;
+        return details::make_local_time(tm);
+    }
+};
+
+// new file every hour, logs/app.txt -> logs/app_2024-05-01_13.txt
+struct hourly_rotation {
+    void validate() const {}
+
+    static std::string calc_filename(const std::string &filename, const std::tm &tm) {
+        auto [basename, ext] = file_helper::split_by_extension(filename);
+        return std::format("{}_{:04}-{:02}-{:02}_{:02}{}", basename, tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, ext);
+    }
+
+    log_clock::time_point next_rotation(log_clock::time_point now) const {
+        std::tm tm = details::local_tm(now);
+        tm.tm_min = 0;
+        tm.tm_sec = 0;
+        tm.tm_hour += 1;
+        return details::make_local_time(tm);
+    }
+
+    static log_clock::time_point previous(log_clock::time_point now, int periods) {
+        return now - std::chrono::hours(periods);
+    }
+};
+
+// switches to a new file when a message is at or past the precomputed next rotation point,
+// so the check per message is one time_point comparison. closed files are optionally
+// gzipped and the oldest beyond max_files removed, both on a low priority background thread
+template <typename Mutex, typename Rotation>
+class periodic_file_sink final : public base_sink<Mutex> {
+public:
+    periodic_file_sink(std::string base_filename,
+                       Rotation rotation = {},
+                       bool truncate = false,
+                       uint16_t max_files = 0,
+                       bool compress = false)
+        : base_filename_(std::move(base_filename)),
+          rotation_(rotation),
+          truncate_(truncate),
+          max_files_(max_files),
+          compress_(compress),
+          worker_(true) {
+        rotation_.validate();
+        auto now = log_clock::now();
+        file_helper_.open(Rotation::calc_filename(base_filename_, details::local_tm(now)), truncate_);
+        rotation_tp_ = rotation_.next_rotation(now);
+        if (max_files_ > 0) {
+            init_filenames_(now);
+        }
+    }
+
+    const std::string &filename() const {
+        return file_helper_.filename();
+    }
+
+    // blocks until closed files have been compressed and old ones removed
+    void wait_background_work() {
+        worker_.wait_idle();
+    }
+
+protected:
+    void sink_it_(const log_msg &msg) override {
+        if (msg.time >= rotation_tp_) {
+            rotate_(msg.time);
+        }
+        file_helper_.write(this->format_(msg));
+    }
+
+    void sink_batch_(std::span<const log_msg> msgs) override {
+        this->formatted_.clear();
+        for (const auto &msg : msgs) {
+            if (!this->should_log(msg.level)) {
+                continue;
+            }
+            if (msg.time >= rotation_tp_) {
+                file_helper_.write(this->formatted_);
+                this->formatted_.clear();
+                rotate_(msg.time);
+            }
+            this->formatter_->format(msg, this->formatted_);
+        }
+        file_helper_.write(this->formatted_);
+    }
+
+    void flush_() override {
+        file_helper_.flush();
+    }
+
+private:
+    std::string base_filename_;
+    Rotation rotation_;
+    bool truncate_;
+    uint16_t max_files_;
+    bool compress_;
+    log_clock::time_point rotation_tp_;
+    file_helper file_helper_;
+    // closed files still on disk, oldest first, without the .gz suffix
+    std::deque<std::string> filenames_;
+    background_worker worker_;
+
+    // a rotation time other than midnight can land on the name of the open file, which
+    // then stays open, reopening it with truncate_ would throw away the period so far
+    void rotate_(log_clock::time_point now) {
+        rotation_tp_ = rotation_.next_rotation(now);
+        std::string next = Rotation::calc_filename(base_filename_, details::local_tm(now));
+        if (next == file_helper_.filename()) {
+            return;
+        }
+        std::string closed = file_helper_.filename();
+        file_helper_.close();
+        file_helper_.open(next, truncate_);
+
+        std::vector<std::string> expired;
+        if (max_files_ > 0) {
+            filenames_.push_back(closed);
+            // the open file counts towards max_files
+            while (filenames_.size() >= max_files_) {
+                expired.push_back(std::move(filenames_.front()));
+                filenames_.pop_front();
+            }
+        }
+        if (compress_ || !expired.empty()) {
+            worker_.post([closed = std::move(closed), expired = std::move(expired), compress = compress_] {
+                if (compress) {
+                    gzip_file_(closed);
+                }
+                std::error_code ec;
+                for (const auto &name : expired) {
+                    std::filesystem::remove(name, ec);
+                    std::filesystem::remove(name + ".gz", ec);
+                }
+            });
+        }
+    }
+
+    // files of earlier periods that are still around, so max_files holds across restarts
+    void init_filenames_(log_clock::time_point now) {
+        for (int periods = max_files_ - 1; periods > 0; --periods) {
+            auto name = Rotation::calc_filename(base_filename_, details::local_tm(Rotation::previous(now, periods)));
+            std::error_code ec;
+            if (std::filesystem::exists(name, ec) || std::filesystem::exists(name + ".gz", ec)) {
+                filenames_.push_back(std::move(name));
+            }
+        }
+    }
+
+    // name -> name.gz, written under a temporary name so a half written archive never shows up
+    static void gzip_file_(const std::string &filename) {
+        std::ifstream in(filename, std::ios::binary);
+        if (!in) {
+            return;
+        }
+        std::string tmp_name = filename + ".gz.tmp";
+        gzFile out = gzopen(tmp_name.c_str(), "wb6");
+        if (out == nullptr) {
+            std::fprintf(stderr, "daily_file_sink: failed opening %s\n", tmp_name.c_str());
+            return;
+        }
+        std::vector<char> buf(64 * 1024);
+        bool ok = true;
+        while (in.read(buf.data(), static_cast<std::streamsize>(buf.size())) || in.gcount() > 0) {
+            auto n = static_cast<unsigned>(in.gcount());
+            if (gzwrite(out, buf.data(), n) != static_cast<int>(n)) {
+                ok = false;
+                break;
+            }
+        }
+        ok = gzclose(out) == Z_OK && ok;
+        std::error_code ec;
+        if (!ok) {
+            std::fprintf(stderr, "daily_file_sink: failed compressing %s\n", filename.c_str());
+            std::filesystem::remove(tmp_name, ec);
+            return;
+        }
+        std::filesystem::rename(tmp_name, filename + ".gz", ec);
+        if (!ec) {
+            std::filesystem::remove(filename, ec);
+        }
+    }
+};
+
+template <typename Mutex>
+using daily_file_sink = periodic_file_sink<Mutex, daily_rotation>;
+template <typename Mutex>
+using hourly_file_sink = periodic_file_sink<Mutex, hourly_rotation>;
+
+using daily_file_sink_mt = daily_file_sink<std::mutex>;
+using daily_file_sink_st = daily_file_sink<null_mutex>;
+using hourly_file_sink_mt = hourly_file_sink<std::mutex>;
+using hourly_file_sink_st = hourly_file_sink<null_mutex>;
+} // end of namespace sinks
+
+template <typename Factory = synchronous_factory>
+std::shared_ptr<logger> daily_logger_mt(const std::string &logger_name,
+                                        const std::string &filename,
+                                        int hour = 0,
+                                        int minute = 0,
+                                        bool truncate = false,
+                                        uint16_t max_files = 0,
+                                        bool compress = false)
+{
+    return Factory::template create<sinks::daily_file_sink_mt>(logger_name, filename, sinks::daily_rotation{hour, minute},
+                                                               truncate, max_files, compress);
+}
+
+template <typename Factory = synchronous_factory>
+std::shared_ptr<logger> daily_logger_st(const std::string &logger_name,
+                                        const std::string &filename,
+                                        int hour = 0,
+                                        int minute = 0,
+                                        bool truncate = false,
+                                        uint16_t max_files = 0,
+                                        bool compress = false)
+{
+    return Factory::template create<sinks::daily_file_sink_st>(logger_name, filename, sinks::daily_rotation{hour, minute},
+                                                               truncate, max_files, compress);
+}
+
+template <typename Factory = synchronous_factory>
+std::shared_ptr<logger> hourly_logger_mt(const std::string &logger_name,
+                                         const std::string &filename,
+                                         bool truncate = false,
+                                         uint16_t max_files = 0,
+                                         bool compress = false)
+{
+    return Factory::template create<sinks::hourly_file_sink_mt>(logger_name, filename, sinks::hourly_rotation{},
+                                                                truncate, max_files, compress);
+}
+
+template <typename Factory = synchronous_factory>
+std::shared_ptr<logger> hourly_logger_st(const std::string &logger_name,
+                                         const std::string &filename,
+                                         bool truncate = false,
+                                         uint16_t max_files = 0,
+                                         bool compress = false)
+{
+    return Factory::template create<sinks::hourly_file_sink_st>(logger_name, filename, sinks::hourly_rotation{},
+                                                                truncate, max_files, compress);
+}
+}
@@ -1,53 +1,209 @@
 #pragma once
 
-#include <filesystem>
-#include <format>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <stdexcept>
 #include <string>
-#include <iostream>
-#include <magic_enum.hpp>
-#include <mysql++/mysql++.h>
+#include <thread>
+#include <vector>
 
 #include <minilog/log_msg.h>
+#include <minilog/null_mutex.h>
+#include <minilog/sinks/base_sink.h>
 
 namespace minilog::sinks {
-class DBSink {
+
+// one row of the logs table, the message is the only part copied out of the log_msg
+struct db_row {
+    log_clock::time_point time;
+    level::level_enum level{level::off};
+    std::string message;
+    // from std::source_location, static storage
+    const char *file_name{""};
+    uint32_t line{0};
+};
+
+// stores a batch of rows, called from the db_sink thread only. throws on failure,
+// the sink reports it and drops the batch
+class db_writer {
 public:
-    static mysqlpp::Connection& getConnection() {
-        static DBSink db_sink;
-        return db_sink.conn;
+    virtual ~db_writer() = default;
+    virtual void write(std::span<const db_row> rows) = 0;
+};
+
+struct db_sink_options {
+    // rows per write() call, i.e. per INSERT
+    size_t batch_size{512};
+    // a partial batch waits at most this long
+    std::chrono::milliseconds flush_interval{1000};
+    // rows waiting for the writer before logging threads block, at least batch_size
+    size_t max_pending_rows{64 * 1024};
+};
+
+// queues rows and hands them to a db_writer on its own thread, a batch goes out once
+// batch_size rows are waiting or flush_interval has passed. the logging thread only copies
+// the message into a row that is reused from earlier batches. flush() waits until every
+// row logged so far has been written or has failed
+template <typename Mutex>
+class db_sink final : public base_sink<Mutex> {
+public:
+    explicit db_sink(std::unique_ptr<db_writer> writer, db_sink_options options = {})
+        : writer_(std::move(writer)), options_(options) {
+        if (writer_ == nullptr) {
+            throw std::runtime_error("db_sink: writer must not be null");
+        }
+        if (options_.batch_size == 0 || options_.max_pending_rows == 0) {
+            throw std::runtime_error("db_sink: batch_size and max_pending_rows must be positive");
+        }
+        // a full buffer must hold a full batch, the thread would only wake for it after flush_interval
+        if (options_.max_pending_rows < options_.batch_size) {
+            throw std::runtime_error("db_sink: max_pending_rows must not be less than batch_size");
+        }
+        thread_ = std::jthread([this](std::stop_token stop) { run_(stop); });
+    }
+
+    ~db_sink() override {
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex_);
+            thread_.request_stop();
+        }
+        work_cv_.notify_one();
+        thread_.join();
+    }
+
+    // rows a writer failed to store
+    size_t failed_rows() const {
+        return failed_rows_.load(std::memory_order_relaxed);
+    }
+
+protected:
+    void sink_it_(const log_msg &msg) override {
+        std::unique_lock<std::mutex> lock(queue_mutex_);
+        wait_for_room_(lock);
+        append_row_(msg);
+        notify_if_full_();
+    }
+
+    void sink_batch_(std::span<const log_msg> msgs) override {
+        std::unique_lock<std::mutex> lock(queue_mutex_);
+        for (const auto &msg : msgs) {
+            if (this->should_log(msg.level)) {
+                wait_for_room_(lock);
+                append_row_(msg);
+            }
+        }
+        notify_if_full_();
+    }
+
+    void flush_() override {
+        std::unique_lock<std::mutex> lock(queue_mutex_);
+        uint64_t target = queued_;
+        if (done_ >= target) {
+            return;
+        }
+        flush_requested_ = true;
+        work_cv_.notify_one();
+        done_cv_.wait(lock, [&] { return done_ >= target; });
     }
 
-    DBSink(const DBSink &) = delete;
-    DBSink& operator=(const DBSink &) = delete;
 private:
-    DBSink() : conn("logs", std::getenv("MINILOG_DB_HOST"), std::getenv("MINILOG_DB_USER"), std::getenv("MINILOG_DB_PASSWORD")) {}
-    mysqlpp::Connection conn;
-};
+    std::unique_ptr<db_writer> writer_;
+    db_sink_options options_;
+
+    std::mutex queue_mutex_;
+    std::condition_variable_any work_cv_;
+    std::condition_variable done_cv_;
+    // the first pending_size_ rows are live, the rest keep their capacity for reuse
+    std::vector<db_row> pending_;
+    size_t pending_size_{0};
+    bool flush_requested_{false};
+    // rows accepted and rows written or failed, flush() waits for the second to catch up
+    uint64_t queued_{0};
+    uint64_t done_{0};
+    std::atomic<size_t> failed_rows_{0};
+    // declared last so the members above outlive the thread
+    std::jthread thread_;
+
+    void wait_for_room_(std::unique_lock<std::mutex> &lock) {
+        if (pending_size_ >= options_.max_pending_rows) {
+            work_cv_.notify_one();
+            done_cv_.wait(lock, [&] { return pending_size_ < options_.max_pending_rows; });
+        }
+    }
+
+    void append_row_(const log_msg &msg) {
+        if (pending_size_ == pending_.size()) {
+            pending_.emplace_back();
+        }
+        db_row &row = pending_[pending_size_++];
+        row.time = msg.time;
+        row.level = msg.level;
+        row.message.assign(msg.payload.data(), msg.payload.size());
+        row.file_name = msg.location.file_name();
+        row.line = msg.location.line();
+        ++queued_;
+    }
+
+    void notify_if_full_() {
+        if (pending_size_ >= options_.batch_size) {
+            work_cv_.notify_one();
+        }
+    }
+
+    void run_(std::stop_token stop) {
+        std::vector<db_row> writing;
+        std::unique_lock<std::mutex> lock(queue_mutex_);
+        while (true) {
+            auto deadline = std::chrono::steady_clock::now() + options_.flush_interval;
+            work_cv_.wait_until(lock, stop, deadline, [&] {
+                return pending_size_ >= options_.batch_size || flush_requested_;
+            });
+            bool stopping = stop.stop_requested();
+            if (pending_size_ == 0) {
+                flush_requested_ = false;
+                if (stopping) {
+                    return;
+                }
+                continue;
+            }
 
-inline void sink_to_db(const log_msg &msg) {
-    try {
-        mysqlpp::Connection conn = DBSink::getConnection();
-        if (conn.connected()) {
-            std::filesystem::path absolute_path = msg.location.file_name();
-            const char *sql_stat = "INSERT INTO logs (log_time, level, message, filename, linenumber) VALUES (%0q, %1q, %2q, %3q, %4q);";
-            
-            //     msg.time, magic_enum::enum_name(msg.level), msg.payload, std::string(absolute_path.filename()), msg.location.line());
-            // std::cout << std::string(10, '-') << std::endl;
-            // std::cout << sql_stat << std::endl;
-            // std::cout << std::string(10, '-') << std::endl;
-            mysqlpp::Query query = conn.query(sql_stat);
-            query.parse();
-            if (auto res = query.execute(
-                format("{}", msg.time).c_str(),
-                std::string(magic_enum::enum_name(msg.level)).c_str(),
-                std::string(msg.payload).c_str(),
-                std::string(absolute_path.filename()).c_str(),
-                std::format("{}",msg.location.line()).c_str())) {
-                std::cout << "inserted " << res.rows() << " rows into the table" << std::endl;
-            }            
-        }
-    } catch (const std::exception &e) {
-        std::cerr << e.what() << std::endl;
+            // swap the buffers, logging threads fill the other one while this batch is written
+            size_t count = pending_size_;
+            pending_.swap(writing);
+            pending_size_ = 0;
+            flush_requested_ = false;
+            done_cv_.notify_all();
+            lock.unlock();
+
+            for (size_t first = 0; first < count; first += options_.batch_size) {
+                size_t n = std::min(options_.batch_size, count - first);
+                write_batch_(std::span<const db_row>(writing.data() + first, n));
+            }
+
+            lock.lock();
+            done_ += count;
+            done_cv_.notify_all();
+        }
     }
+
+    void write_batch_(std::span<const db_row> rows) {
+        try {
+            writer_->write(rows);
+        } catch (const std::exception &ex) {
+            failed_rows_.fetch_add(rows.size(), std::memory_order_relaxed);
+            std::fprintf(stderr, "db_sink: failed writing %zu rows: %s\n", rows.size(), ex.what());
+        }
+    }
+};
+
+using db_sink_mt = db_sink<std::mutex>;
+using db_sink_st = db_sink<null_mutex>;
 }
-}
\ No newline at end of file
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <source_location>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <minilog/common.h>
+#include <minilog/log_msg.h>
+#include <minilog/null_mutex.h>
+#include <minilog/sinks/base_sink.h>
+
+namespace minilog::sinks {
+
+// forwards to the wrapped sinks, dropping a message with the same level and payload as the
+// previous one while less than max_skip_duration has passed since the last one forwarded.
+// the next different message or flush() first writes "message repeated N times". payloads
+// are compared by length and hash, the text of the previous message is not kept
+template <typename Mutex>
+class dup_filter_sink final : public base_sink<Mutex> {
+public:
+    dup_filter_sink(std::chrono::nanoseconds max_skip_duration, std::vector<std::shared_ptr<sink>> sinks)
+        : max_skip_duration_(max_skip_duration), sinks_(std::move(sinks)) {}
+
+    // messages dropped since the last summary line
+    size_t skipped() {
+        std::lock_guard<Mutex> lock(this->mutex_);
+        return skip_count_;
+    }
+
+protected:
+    void sink_it_(const log_msg &msg) override {
+        uint64_t hash = std::hash<std::string_view>{}(msg.payload);
+        if (is_repeat_(msg, hash)) {
+            ++skip_count_;
+            return;
+        }
+        write_skipped_(msg.time);
+
+        forward_(msg);
+        last_hash_ = hash;
+        last_size_ = msg.payload.size();
+        last_level_ = msg.level;
+        last_time_ = msg.time;
+        last_logger_name_.assign(msg.logger_name);
+        last_location_ = msg.location;
+        has_last_ = true;
+    }
+
+    void flush_() override {
+        write_skipped_(log_clock::now());
+        for (auto &s : sinks_) {
+            s->flush();
+        }
+    }
+
+    void set_pattern_(const std::string &pattern) override {
+        for (auto &s : sinks_) {
+            s->set_pattern(pattern);
+        }
+    }
+
+    void set_formatter_(std::unique_ptr<minilog::formatter> sink_formatter) override {
+        for (auto &s : sinks_) {
+            s->set_formatter(sink_formatter->clone());
+        }
+    }
+
+private:
+    std::chrono::nanoseconds max_skip_duration_;
+    std::vector<std::shared_ptr<sink>> sinks_;
+
+    bool has_last_{false};
+    uint64_t last_hash_{0};
+    size_t last_size_{0};
+    level::level_enum last_level_{level::off};
+    log_clock::time_point last_time_;
+    // the summary line reuses the name and location of the message it counts
+    std::string last_logger_name_;
+    std::source_location last_location_;
+    size_t skip_count_{0};
+    memory_buf_t summary_;
+
+    bool is_repeat_(const log_msg &msg, uint64_t hash) const {
+        return has_last_ && hash == last_hash_ && msg.payload.size() == last_size_ && msg.level == last_level_ &&
+               msg.time - last_time_ < max_skip_duration_;
+    }
+
+    void write_skipped_(log_clock::time_point time) {
+        if (skip_count_ == 0) {
+            return;
+        }
+        summary_.clear();
+        std::format_to(std::back_inserter(summary_), "message repeated {} times", skip_count_);
+        skip_count_ = 0;
+        log_msg summary(last_logger_name_, last_level_, summary_.view(), last_location_);
+        summary.time = time;
+        forward_(summary);
+    }
+
+    void forward_(const log_msg &msg) {
+        for (auto &s : sinks_) {
+            if (s->should_log(msg.level)) {
+                s->log(msg);
+            }
+        }
+    }
+};
+
+using dup_filter_sink_mt = dup_filter_sink<std::mutex>;
+using dup_filter_sink_st = dup_filter_sink<null_mutex>;
+}
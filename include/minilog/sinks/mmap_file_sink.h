@@ -0,0 +1,181 @@
+#pragma once
+
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <minilog/null_mutex.h>
+#include <minilog/sinks/base_sink.h>
+#include <minilog/synchronous_factory.h>
+
+namespace minilog {
+namespace sinks {
+
+// copies formatted lines straight into a shared mapping of the file. the file is grown
+// chunk_size bytes at a time with ftruncate and remapped when full, the kernel writes the
+// pages back on its own, flush() forces it with msync. on close the file is cut back to
+// the bytes actually written; after a crash it keeps the zero filled rest of the last chunk
+template <typename Mutex>
+class mmap_file_sink final : public base_sink<Mutex> {
+public:
+    static constexpr size_t default_chunk_size = 16 * 1024 * 1024;
+
+    explicit mmap_file_sink(const std::string &filename, bool truncate = true, size_t chunk_size = default_chunk_size)
+        : filename_(filename), chunk_size_(round_to_pages_(chunk_size)) {
+        auto parent = std::filesystem::path(filename).parent_path();
+        std::error_code ec;
+        if (!parent.empty()) {
+            std::filesystem::create_directories(parent, ec);
+        }
+        fd_ = ::open(filename.c_str(), O_RDWR | O_CREAT | O_CLOEXEC | (truncate ? O_TRUNC : 0), 0644);
+        if (fd_ < 0) {
+            throw_errno_("failed opening file " + filename);
+        }
+        struct stat st{};
+        if (::fstat(fd_, &st) != 0) {
+            int err = errno;
+            ::close(fd_);
+            throw_errno_("failed reading the size of " + filename, err);
+        }
+        size_ = static_cast<size_t>(st.st_size);
+        synced_ = size_;
+        try {
+            grow_(size_);
+        } catch (...) {
+            ::close(fd_);
+            throw;
+        }
+    }
+
+    ~mmap_file_sink() override {
+        if (data_ != nullptr) {
+            ::munmap(data_, mapped_size_);
+        }
+        if (fd_ >= 0) {
+            (void)::ftruncate(fd_, static_cast<off_t>(size_));
+            ::close(fd_);
+        }
+    }
+
+    const std::string &filename() const {
+        return filename_;
+    }
+
+protected:
+    void sink_it_(const log_msg &msg) override {
+        write_(this->format_(msg));
+    }
+
+    void sink_batch_(std::span<const log_msg> msgs) override {
+        this->formatted_.clear();
+        for (const auto &msg : msgs) {
+            if (this->should_log(msg.level)) {
+                this->formatter_->format(msg, this->formatted_);
+            }
+        }
+        write_(this->formatted_);
+    }
+
+    // writes back only the pages dirtied since the last flush
+    void flush_() override {
+        if (size_ == synced_) {
+            return;
+        }
+        size_t start = synced_ / page_size_() * page_size_();
+        if (::msync(data_ + start, size_ - start, MS_SYNC) != 0) {
+            throw_errno_("msync failed on " + filename_);
+        }
+        synced_ = size_;
+    }
+
+private:
+    std::string filename_;
+    size_t chunk_size_;
+    int fd_{-1};
+    char *data_{nullptr};
+    size_t mapped_size_{0};
+    size_t size_{0};
+    size_t synced_{0};
+
+    static size_t page_size_() {
+        static const size_t page_size = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+        return page_size;
+    }
+
+    static size_t round_to_pages_(size_t n) {
+        size_t page = page_size_();
+        return (n + page - 1) / page * page;
+    }
+
+    [[noreturn]] static void throw_errno_(const std::string &what, int err = errno) {
+        throw std::runtime_error(what + ": " + std::strerror(err));
+    }
+
+    void write_(const memory_buf_t &buf) {
+        if (buf.empty()) {
+            return;
+        }
+        if (size_ + buf.size() > mapped_size_) {
+            grow_(size_ + buf.size());
+        }
+        std::memcpy(data_ + size_, buf.data(), buf.size());
+        size_ += buf.size();
+    }
+
+    // makes the file and the mapping at least min_size, rounded up to whole chunks
+    void grow_(size_t min_size) {
+        size_t new_size = (min_size / chunk_size_ + 1) * chunk_size_;
+        if (::ftruncate(fd_, static_cast<off_t>(new_size)) != 0) {
+            throw_errno_("failed growing " + filename_);
+        }
+        void *mapped;
+#ifdef __linux__
+        if (data_ != nullptr) {
+            mapped = ::mremap(data_, mapped_size_, new_size, MREMAP_MAYMOVE);
+        } else {
+            mapped = ::mmap(nullptr, new_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+        }
+#else
+        if (data_ != nullptr) {
+            ::munmap(data_, mapped_size_);
+            data_ = nullptr;
+        }
+        mapped = ::mmap(nullptr, new_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+#endif
+        if (mapped == MAP_FAILED) {
+            throw_errno_("failed mapping " + filename_);
+        }
+        data_ = static_cast<char *>(mapped);
+        mapped_size_ = new_size;
+    }
+};
+
+using mmap_file_sink_mt = mmap_file_sink<std::mutex>;
+using mmap_file_sink_st = mmap_file_sink<null_mutex>;
+} // end of namespace sinks
+
+template <typename Factory = synchronous_factory>
+std::shared_ptr<logger> mmap_logger_mt(const std::string &logger_name,
+                                       const std::string &filename,
+                                       bool truncate = true)
+{
+    return Factory::template create<sinks::mmap_file_sink_mt>(logger_name, filename, truncate);
+}
+
+template <typename Factory = synchronous_factory>
+std::shared_ptr<logger> mmap_logger_st(const std::string &logger_name,
+                                       const std::string &filename,
+                                       bool truncate = true)
+{
+    return Factory::template create<sinks::mmap_file_sink_st>(logger_name, filename, truncate);
+}
+}
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <cstdlib>
+#include <format>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <magic_enum.hpp>
+#include <mysql++/mysql++.h>
+
+#include <minilog/synchronous_factory.h>
+#include <minilog/sinks/db_sink.h>
+#include <minilog/time_cache.h>
+
+namespace minilog {
+namespace sinks {
+
+struct db_config {
+    std::string database{"logs"};
+    std::string server;
+    std::string user;
+    std::string password;
+    unsigned int port{0};
+    std::string table{"logs"};
+
+    // MINILOG_DB_HOST, MINILOG_DB_USER and MINILOG_DB_PASSWORD
+    static db_config from_env() {
+        auto env = [](const char *name) {
+            const char *value = std::getenv(name);
+            return value ? std::string(value) : std::string();
+        };
+        db_config config;
+        config.server = env("MINILOG_DB_HOST");
+        config.user = env("MINILOG_DB_USER");
+        config.password = env("MINILOG_DB_PASSWORD");
+        return config;
+    }
+};
+
+// connections are opened on demand and closed after max_idle_seconds unused,
+// several db_sinks can share one pool
+class db_connection_pool final : public mysqlpp::ConnectionPool {
+public:
+    explicit db_connection_pool(db_config config, unsigned int max_idle_seconds = 60)
+        : config_(std::move(config)), max_idle_seconds_(max_idle_seconds) {}
+
+    ~db_connection_pool() override {
+        clear();
+    }
+
+    const db_config &config() const {
+        return config_;
+    }
+
+protected:
+    mysqlpp::Connection *create() override {
+        auto or_null = [](const std::string &s) { return s.empty() ? nullptr : s.c_str(); };
+        return new mysqlpp::Connection(config_.database.c_str(), or_null(config_.server), or_null(config_.user),
+                                       or_null(config_.password), config_.port);
+    }
+
+    void destroy(mysqlpp::Connection *conn) override {
+        delete conn;
+    }
+
+    unsigned int max_idle_time() override {
+        return max_idle_seconds_;
+    }
+
+private:
+    db_config config_;
+    unsigned int max_idle_seconds_;
+};
+
+// writes each batch as one multi-row INSERT. mysql++ templates take a fixed number of
+// parameters, so instead of a %0q template the statement prefix is built once and the
+// rows are escaped into a statement buffer kept across batches
+class mysql_writer final : public db_writer {
+public:
+    explicit mysql_writer(std::shared_ptr<db_connection_pool> pool)
+        : pool_(std::move(pool)),
+          insert_prefix_(std::format("INSERT INTO `{}` (log_time, level, message, filename, linenumber) VALUES ",
+                                     pool_->config().table)) {}
+
+    void write(std::span<const db_row> rows) override {
+        if (rows.empty()) {
+            return;
+        }
+        mysqlpp::ScopedConnection conn(*pool_, true);
+        mysqlpp::Query query = conn->query();
+        statement_.assign(insert_prefix_);
+        for (size_t i = 0; i < rows.size(); ++i) {
+            const db_row &row = rows[i];
+            if (i > 0) {
+                statement_ += ',';
+            }
+            statement_ += "('";
+            statement_ += format_time(row.time).substr(0, time_cache::datetime_length);
+            statement_ += "','";
+            statement_ += magic_enum::enum_name(row.level);
+            statement_ += "','";
+            append_escaped_(query, row.message);
+            statement_ += "','";
+            append_escaped_(query, base_name_(row.file_name));
+            statement_ += std::format("',{})", row.line);
+        }
+        if (!query.exec(statement_)) {
+            throw std::runtime_error(std::string("mysql_writer: ") + query.error());
+        }
+    }
+
+private:
+    std::shared_ptr<db_connection_pool> pool_;
+    const std::string insert_prefix_;
+    std::string statement_;
+    std::string escaped_;
+
+    static std::string_view base_name_(std::string_view path) {
+        auto slash = path.find_last_of("/\\");
+        return slash == std::string_view::npos ? path : path.substr(slash + 1);
+    }
+
+    // escape_string falls back to strlen for a zero length
+    void append_escaped_(const mysqlpp::Query &query, std::string_view text) {
+        if (text.empty()) {
+            return;
+        }
+        query.escape_string(&escaped_, text.data(), text.size());
+        statement_ += escaped_;
+    }
+};
+
+} // end of namespace sinks
+
+// rows are written by the sink's own thread, batch_size rows per INSERT
+template <typename Factory = synchronous_factory>
+std::shared_ptr<logger> db_logger_mt(const std::string &logger_name,
+                                     std::shared_ptr<sinks::db_connection_pool> pool,
+                                     sinks::db_sink_options options = {})
+{
+    return Factory::template create<sinks::db_sink_mt>(logger_name, std::make_unique<sinks::mysql_writer>(std::move(pool)), options);
+}
+
+template <typename Factory = synchronous_factory>
+std::shared_ptr<logger> db_logger_st(const std::string &logger_name,
+                                     std::shared_ptr<sinks::db_connection_pool> pool,
+                                     sinks::db_sink_options options = {})
+{
+    return Factory::template create<sinks::db_sink_st>(logger_name, std::make_unique<sinks::mysql_writer>(std::move(pool)), options);
+}
+}
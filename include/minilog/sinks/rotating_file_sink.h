@@ -0,0 +1,253 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <filesystem>
+#include <format>
+#include <mutex>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <minilog/background_worker.h>
+#include <minilog/file_helper.h>
+#include <minilog/null_mutex.h>
+#include <minilog/sinks/base_sink.h>
+#include <minilog/synchronous_factory.h>
+
+namespace minilog {
+namespace sinks {
+
+// writes to base_filename and rotates when it would grow past max_size:
+// log.txt -> log.1.txt -> log.2.txt ... -> log.{max_files}.txt, the oldest is removed.
+// the writing thread only renames the full file to a pending name and opens a new,
+// preallocated one, shifting the older files happens on a background thread. pending
+// files a previous process left behind are shifted in first, oldest first
+template <typename Mutex>
+class rotating_file_sink final : public base_sink<Mutex> {
+public:
+    rotating_file_sink(std::string base_filename, size_t max_size, size_t max_files, bool rotate_on_open = false)
+        : base_filename_(std::move(base_filename)), max_size_(max_size), max_files_(max_files) {
+        if (max_size == 0) {
+            throw std::runtime_error("rotating sink constructor: max_size arg cannot be zero");
+        }
+        if (max_files > 200000) {
+            throw std::runtime_error("rotating sink constructor: max_files arg cannot exceed 200000");
+        }
+        recover_pending_();
+        file_helper_.open(base_filename_, false);
+        if (rotate_on_open && file_helper_.size() > 0) {
+            rotate_();
+        } else {
+            preallocate_(base_filename_, max_size_);
+        }
+    }
+
+    ~rotating_file_sink() override {
+        try {
+            file_helper_.close();
+        } catch (const std::exception &e) {
+            std::fprintf(stderr, "rotating_file_sink: %s\n", e.what());
+        }
+        release_preallocation_(base_filename_);
+    }
+
+    // log.txt, 3 -> log.3.txt
+    static std::string calc_filename(const std::string &filename, size_t index) {
+        if (index == 0) {
+            return filename;
+        }
+        auto [basename, ext] = file_helper::split_by_extension(filename);
+        return std::format("{}.{}{}", basename, index, ext);
+    }
+
+    const std::string &filename() const {
+        return base_filename_;
+    }
+
+    // blocks until the files of every rotation so far have been shifted into place
+    void wait_rotations() {
+        worker_.wait_idle();
+    }
+
+protected:
+    void sink_it_(const log_msg &msg) override {
+        const auto &formatted = this->format_(msg);
+        if (file_helper_.size() > 0 && file_helper_.size() + formatted.size() > max_size_) {
+            rotate_();
+        }
+        file_helper_.write(formatted);
+    }
+
+    // writes the batch in as few chunks as the rotations allow
+    void sink_batch_(std::span<const log_msg> msgs) override {
+        this->formatted_.clear();
+        for (const auto &msg : msgs) {
+            if (!this->should_log(msg.level)) {
+                continue;
+            }
+            line_.clear();
+            this->formatter_->format(msg, line_);
+            size_t file_size = file_helper_.size() + this->formatted_.size();
+            if (file_size > 0 && file_size + line_.size() > max_size_) {
+                file_helper_.write(this->formatted_);
+                this->formatted_.clear();
+                rotate_();
+            }
+            this->formatted_.append(line_.view());
+        }
+        file_helper_.write(this->formatted_);
+    }
+
+    void flush_() override {
+        file_helper_.flush();
+    }
+
+private:
+    std::string base_filename_;
+    size_t max_size_;
+    size_t max_files_;
+    size_t rotation_seq_{0};
+    file_helper file_helper_;
+    memory_buf_t line_;
+    // declared last, finishes the pending renames before the rest goes away
+    background_worker worker_;
+
+    // log.txt, 3 -> log.pending-3.txt
+    std::string pending_filename_(size_t seq) const {
+        auto [basename, ext] = file_helper::split_by_extension(base_filename_);
+        return std::format("{}.pending-{}{}", basename, seq, ext);
+    }
+
+    // a process that stopped between a rename and its shift leaves pending files behind.
+    // they are newer than the numbered files, so they are shifted in oldest first, and
+    // this process numbers its own pending files past them
+    void recover_pending_() {
+        namespace fs = std::filesystem;
+        auto [basename, ext] = file_helper::split_by_extension(base_filename_);
+        fs::path base_path(basename);
+        auto dir = base_path.parent_path().empty() ? fs::path(".") : base_path.parent_path();
+        auto prefix = base_path.filename().string() + ".pending-";
+
+        std::vector<size_t> found;
+        std::error_code ec;
+        for (fs::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec)) {
+            auto name = it->path().filename().string();
+            if (!name.starts_with(prefix) || !name.ends_with(ext) || name.size() <= prefix.size() + ext.size()) {
+                continue;
+            }
+            std::string_view digits(name.data() + prefix.size(), name.size() - prefix.size() - ext.size());
+            size_t seq = 0;
+            auto [ptr, parse_ec] = std::from_chars(digits.data(), digits.data() + digits.size(), seq);
+            if (parse_ec == std::errc() && ptr == digits.data() + digits.size()) {
+                found.push_back(seq);
+            }
+        }
+        std::sort(found.begin(), found.end());
+        for (size_t seq : found) {
+            worker_.post([base = base_filename_, pending = pending_filename_(seq), max_files = max_files_] {
+                shift_files_(base, pending, max_files);
+            });
+        }
+        if (!found.empty()) {
+            rotation_seq_ = found.back();
+        }
+    }
+
+    // one rename and one open on the writing thread, the rest is posted to worker_
+    void rotate_() {
+        file_helper_.close();
+        auto pending = pending_filename_(++rotation_seq_);
+
+        std::error_code ec;
+        std::filesystem::rename(base_filename_, pending, ec);
+        if (ec) {
+            file_helper_.open(base_filename_, false);
+            throw std::runtime_error("rotating_file_sink: failed renaming " + base_filename_ + ": " + ec.message());
+        }
+        file_helper_.open(base_filename_, true);
+        preallocate_(base_filename_, max_size_);
+
+        worker_.post([base = base_filename_, pending = std::move(pending), max_files = max_files_] {
+            shift_files_(base, pending, max_files);
+        });
+    }
+
+    static void shift_files_(const std::string &base, const std::string &pending, size_t max_files) {
+        namespace fs = std::filesystem;
+        std::error_code ec;
+        release_preallocation_(pending);
+        if (max_files == 0) {
+            fs::remove(pending, ec);
+            return;
+        }
+        fs::remove(calc_filename(base, max_files), ec);
+        for (size_t i = max_files - 1; i > 0; --i) {
+            auto src = calc_filename(base, i);
+            if (fs::exists(src, ec)) {
+                fs::rename(src, calc_filename(base, i + 1), ec);
+            }
+        }
+        fs::rename(pending, calc_filename(base, 1), ec);
+        if (ec) {
+            std::fprintf(stderr, "rotating_file_sink: failed renaming %s: %s\n", pending.c_str(), ec.message().c_str());
+        }
+    }
+
+    // reserves the blocks of a whole segment up front without changing the file size
+    static void preallocate_(const std::string &filename, size_t size) {
+#ifdef __linux__
+        int fd = ::open(filename.c_str(), O_WRONLY | O_CLOEXEC);
+        if (fd >= 0) {
+            ::fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(size));
+            ::close(fd);
+        }
+#else
+        (void)filename;
+        (void)size;
+#endif
+    }
+
+    // truncating to the current size drops the blocks preallocated past the end
+    static void release_preallocation_(const std::string &filename) {
+        std::error_code ec;
+        auto size = std::filesystem::file_size(filename, ec);
+        if (!ec) {
+            std::filesystem::resize_file(filename, size, ec);
+        }
+    }
+};
+
+using rotating_file_sink_mt = rotating_file_sink<std::mutex>;
+using rotating_file_sink_st = rotating_file_sink<null_mutex>;
+} // end of namespace sinks
+
+template <typename Factory = synchronous_factory>
+std::shared_ptr<logger> rotating_logger_mt(const std::string &logger_name,
+                                           const std::string &filename,
+                                           size_t max_file_size,
+                                           size_t max_files,
+                                           bool rotate_on_open = false)
+{
+    return Factory::template create<sinks::rotating_file_sink_mt>(logger_name, filename, max_file_size, max_files, rotate_on_open);
+}
+
+template <typename Factory = synchronous_factory>
+std::shared_ptr<logger> rotating_logger_st(const std::string &logger_name,
+                                           const std::string &filename,
+                                           size_t max_file_size,
+                                           size_t max_files,
+                                           bool rotate_on_open = false)
+{
+    return Factory::template create<sinks::rotating_file_sink_st>(logger_name, filename, max_file_size, max_files, rotate_on_open);
+}
+}
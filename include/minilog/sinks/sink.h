@@ -1,8 +1,11 @@
 #pragma once
 
+#include <memory>
 #include <mutex>
+#include <span>
 
 #include <minilog/common.h>
+#include <minilog/formatter.h>
 #include <minilog/log_msg.h>
 namespace minilog::sinks {
 
@@ -10,7 +13,25 @@ class sink {
 public:
     virtual ~sink() = default;
     virtual void log(const log_msg &msg) = 0;
+
+    // unlike log(), filters by the sink level itself. the default logs record by record,
+    // sinks that can format the whole batch into one write override it
+    virtual void log_batch(std::span<const log_msg> msgs) {
+        for (const auto &msg : msgs) {
+            if (should_log(msg.level)) {
+                log(msg);
+            }
+        }
+    }
     virtual void flush() = 0;
+
+    // true for sinks that store the format string and encoded arguments of a message
+    // rather than its text, a logger formatting on the calling thread attaches them too
+    virtual bool wants_format_args() const {
+        return false;
+    }
+    virtual void set_pattern(const std::string &pattern) = 0;
+    virtual void set_formatter(std::unique_ptr<minilog::formatter> sink_formatter) = 0;
     
     void set_level(level::level_enum log_level) {
         level_.store(log_level);
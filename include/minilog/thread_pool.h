@@ -1,43 +1,83 @@
 #pragma once
 
 #include "minilog/log_msg.h"
+#include <atomic>
 #include <cassert>
+#include <minilog/byte_ring_q.h>
 #include <minilog/mpmc_blocking_q.h>
+#include <minilog/mpmc_ring_q.h>
+#include <minilog/per_thread_q.h>
 #include <cstddef>
 #include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
 #include <stdexcept>
 #include <thread>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
 namespace minilog {
 
 class async_logger;
+namespace details {
+class async_backend;
+}
 enum class async_overflow_policy {
     block,
     overrun_oldest,
     discard_new
 };
 
+// blocking: std::queue guarded by a mutex and condition variables
+// lock_free: bounded ring with per slot sequence numbers, capacity rounded up to a power of two
+// per_thread: one spsc ring of q_max_items per producer thread, merged by timestamp, single worker only
+// byte_ring: records copied inline into one preallocated buffer of q_max_items bytes, records larger
+//            than a quarter of it are formatted on the spot and have their payload truncated
+enum class async_queue_kind {
+    blocking,
+    lock_free,
+    per_thread,
+    byte_ring
+};
+
+// owns copies of the logger name, the payload and, for deferred formatting,
+// the encoded arguments and any format string that isn't a literal
 class log_msg_buffer : public log_msg {
     std::string buffer;
+    void fill_buffer() {
+        buffer.append(logger_name.begin(), logger_name.end());
+        buffer.append(payload.begin(), payload.end());
+        buffer.append(format_args.begin(), format_args.end());
+        if (!static_format_string) {
+            buffer.append(format_string.begin(), format_string.end());
+        }
+    }
     void update_string_views() {
-        logger_name = std::string_view{buffer.data(), logger_name.size()};
-        payload = std::string_view{buffer.data() + logger_name.size(), payload.size()};
+        const char *cursor = buffer.data();
+        logger_name = std::string_view{cursor, logger_name.size()};
+        cursor += logger_name.size();
+        payload = std::string_view{cursor, payload.size()};
+        cursor += payload.size();
+        format_args = std::string_view{cursor, format_args.size()};
+        cursor += format_args.size();
+        if (!static_format_string) {
+            format_string = std::string_view{cursor, format_string.size()};
+        }
     }
 
 public:
     log_msg_buffer() = default;
     explicit log_msg_buffer(const log_msg& orig_msg)
         : log_msg(orig_msg) {
-        buffer.append(logger_name.begin(), logger_name.end());
-        buffer.append(payload.begin(), payload.end());
+        fill_buffer();
         update_string_views();
-
     }
     log_msg_buffer(const log_msg_buffer& other)
         : log_msg(other) {
-        buffer.append(logger_name.begin(), logger_name.end());
-        buffer.append(payload.begin(), payload.end());
+        fill_buffer();
         update_string_views();
-
     }
     log_msg_buffer(log_msg_buffer&& other) noexcept
         : log_msg{other}, buffer{std::move(other.buffer)} {
@@ -64,39 +104,75 @@ public:
 
 enum class async_msg_type {log, flush, terminate};
 
+// the promise of the future returned by async_logger::flush() and how many log records
+// the logger had posted when it was called, the flush waits until that many are released
+struct flush_request {
+    std::promise<void> done;
+    size_t logs_posted{0};
+};
+
+// holds a plain pointer to its logger's backend, which counts the record as in flight
+// until release() runs and so outlives every record that still points at it.
+// a flush record carries its flush_request
 struct async_msg : log_msg_buffer {
     async_msg_type msg_type{async_msg_type::log};
-    std::shared_ptr<async_logger> worker_ptr;
+    details::async_backend *worker_ptr{nullptr};
+    std::unique_ptr<flush_request> flush;
 
     async_msg() = default;
-    ~async_msg() = default;
+    ~async_msg() {
+        release();
+    }
 
     async_msg(const async_msg &) = delete;
-    async_msg(async_msg &&) = default;
-    async_msg& operator=(async_msg &&) = default;
+    async_msg(async_msg &&other) noexcept
+        : log_msg_buffer{std::move(other)},
+          msg_type{other.msg_type},
+          worker_ptr{std::exchange(other.worker_ptr, nullptr)},
+          flush{std::move(other.flush)} {}
+    async_msg& operator=(async_msg &&other) noexcept {
+        if (this != &other) {
+            release();
+            log_msg_buffer::operator=(std::move(other));
+            msg_type = other.msg_type;
+            worker_ptr = std::exchange(other.worker_ptr, nullptr);
+            flush = std::move(other.flush);
+        }
+        return *this;
+    }
 
-    async_msg(std::shared_ptr<async_logger>&& worker, async_msg_type the_type, const log_msg& m)
-        : log_msg_buffer{m}, msg_type{the_type}, worker_ptr{std::move(worker)} {}
-    async_msg(std::shared_ptr<async_logger>&& worker, async_msg_type the_type)
-        : log_msg_buffer{}, msg_type{the_type}, worker_ptr{std::move(worker)} {}
+    async_msg(details::async_backend *worker, async_msg_type the_type, const log_msg& m)
+        : log_msg_buffer{m}, msg_type{the_type}, worker_ptr{worker} {}
+    async_msg(details::async_backend *worker, async_msg_type the_type)
+        : log_msg_buffer{}, msg_type{the_type}, worker_ptr{worker} {}
     explicit async_msg(async_msg_type the_type)
         : async_msg{nullptr, the_type} {}
+
+    // done with the logger, whether the record was processed, overrun or discarded.
+    // a flush that never ran leaves its future with a broken_promise error
+    void release() noexcept;
 };
 
 class thread_pool {
+    friend class async_logger;
 public:
     using item_type = async_msg;
-    using q_type = mpmc_blocking_queue<item_type>;
+    using q_type = std::variant<mpmc_blocking_queue<item_type>, mpmc_ring_queue<item_type>,
+                                per_thread_queue<item_type>, byte_ring_queue>;
 
     thread_pool(size_t q_max_items,
                 size_t threads_n,
                 std::function<void()> on_thread_start,
-                std::function<void()> on_thread_stop)
-        : q_(q_max_items)
+                std::function<void()> on_thread_stop,
+                async_queue_kind queue_kind = async_queue_kind::blocking)
+        : q_(make_queue_(queue_kind, q_max_items))
     {
         if (threads_n == 0 || threads_n > 1000) {
             throw std::runtime_error("invalid threads_n params (range is 1-1000)");
         }
+        if (queue_kind == async_queue_kind::per_thread && threads_n != 1) {
+            throw std::runtime_error("per_thread queues are drained by exactly one thread");
+        }
         for (size_t i = 0; i < threads_n; i++) {
             threads_.emplace_back([this, on_thread_start, on_thread_stop] {
                 on_thread_start();
@@ -113,6 +189,9 @@ public:
     
     thread_pool(size_t q_max_items, size_t threads_n)
         : thread_pool(q_max_items, threads_n, [] {}, [] {}) {}
+
+    thread_pool(size_t q_max_items, size_t threads_n, async_queue_kind queue_kind)
+        : thread_pool(q_max_items, threads_n, [] {}, [] {}, queue_kind) {}
     
     ~thread_pool() {
         for (size_t i = 0; i < threads_.size(); i++) {
@@ -123,61 +202,148 @@ public:
     thread_pool(const thread_pool &) = delete;
     thread_pool& operator=(thread_pool &&) = delete;
 
-    void post_log(std::shared_ptr<async_logger>&& worker_ptr,
+    void post_log(details::async_backend *worker_ptr,
                   const log_msg& msg,
                   async_overflow_policy overflow_policy)
     {
-        async_msg async_m(std::move(worker_ptr), async_msg_type::log, msg);
+        if (auto *ring = std::get_if<byte_ring_queue>(&q_)) {
+            post_record_(*ring, worker_ptr, async_msg_type::log, msg, overflow_policy);
+            return;
+        }
+        async_msg async_m(worker_ptr, async_msg_type::log, msg);
         post_async_msg_(std::move(async_m), overflow_policy);
     }
 
-    void post_flush(std::shared_ptr<async_logger>&& worker_ptr,
-                    async_overflow_policy overflow_policy)
+    // the future is ready once logs_posted log records of the logger are released and a
+    // worker has flushed its sinks, on any number of pool threads
+    std::future<void> post_flush(details::async_backend *worker_ptr,
+                                 size_t logs_posted,
+                                 async_overflow_policy overflow_policy)
     {
-        post_async_msg_(async_msg(std::move(worker_ptr), async_msg_type::flush), overflow_policy);
+        async_msg flush_msg(worker_ptr, async_msg_type::flush);
+        flush_msg.flush = std::make_unique<flush_request>();
+        flush_msg.flush->logs_posted = logs_posted;
+        auto done = flush_msg.flush->done.get_future();
+        post_async_msg_(std::move(flush_msg), overflow_policy);
+        return done;
     }
 
     size_t overrun_counter() {
-        return q_.overrun_counter();
+        return std::visit([](auto &q) { return q.overrun_counter(); }, q_);
     }
 
     void reset_overrun_counter() {
-        q_.reset_overrun_counter();
+        std::visit([](auto &q) { q.reset_overrun_counter(); }, q_);
     }
 
     size_t discard_counter() {
-        return q_.discard_counter();
+        return std::visit([](auto &q) { return q.discard_counter(); }, q_);
     }
 
     void reset_discard_counter() {
-        q_.reset_discard_counter();
+        std::visit([](auto &q) { q.reset_discard_counter(); }, q_);
     }
 
     size_t queue_size() {
-        return q_.size();
+        return std::visit([](auto &q) { return q.size(); }, q_);
+    }
+
+    // records cut down to fit a byte_ring queue
+    size_t truncate_counter() {
+        return truncate_counter_.load(std::memory_order_relaxed);
+    }
+
+    void reset_truncate_counter() {
+        truncate_counter_.store(0, std::memory_order_relaxed);
     }
 
 private:
     q_type q_;
+    // backends of destroyed loggers and how many records they posted, declared before
+    // threads_ so they go after the workers stopped. shared_ptr, it can be destroyed where
+    // async_backend is incomplete
+    std::mutex retired_mutex_;
+    std::vector<std::pair<std::shared_ptr<details::async_backend>, size_t>> retired_;
+    std::atomic<bool> has_retired_{false};
+    // flush records still waiting for records held by other workers. they keep their
+    // backend in flight, so they go before retired_
+    std::mutex parked_flushes_mutex_;
+    std::vector<async_msg> parked_flushes_;
+    std::atomic<bool> has_parked_flushes_{false};
     std::vector<std::jthread> threads_;
+    std::atomic<size_t> truncate_counter_{0};
 
-    void post_async_msg_(async_msg&& new_msg, async_overflow_policy overflow_policy) {
-        if (overflow_policy == async_overflow_policy::block) {
-            q_.enqueue(std::move(new_msg));
-        } else if (overflow_policy == async_overflow_policy::overrun_oldest) {
-            q_.enqueue_nowait(std::move(new_msg));
-        } else {
-            assert(overflow_policy == async_overflow_policy::discard_new);
-            q_.enqueue_if_have_room(std::move(new_msg));
+    static q_type make_queue_(async_queue_kind queue_kind, size_t q_max_items) {
+        if (queue_kind == async_queue_kind::lock_free) {
+            return q_type{std::in_place_type<mpmc_ring_queue<item_type>>, q_max_items};
+        }
+        if (queue_kind == async_queue_kind::per_thread) {
+            return q_type{std::in_place_type<per_thread_queue<item_type>>, q_max_items};
         }
+        if (queue_kind == async_queue_kind::byte_ring) {
+            return q_type{std::in_place_type<byte_ring_queue>, q_max_items, &drop_record_};
+        }
+        return q_type{std::in_place_type<mpmc_blocking_queue<item_type>>, q_max_items};
     }
 
+    void post_async_msg_(async_msg&& new_msg, async_overflow_policy overflow_policy) {
+        std::visit([&](auto &q) {
+            if constexpr (std::is_same_v<std::decay_t<decltype(q)>, byte_ring_queue>) {
+                details::async_backend *worker_ptr = std::exchange(new_msg.worker_ptr, nullptr);
+                post_record_(q, worker_ptr, new_msg.msg_type, new_msg, overflow_policy, new_msg.flush.release());
+            } else if (overflow_policy == async_overflow_policy::block) {
+                q.enqueue(std::move(new_msg));
+            } else if (overflow_policy == async_overflow_policy::overrun_oldest) {
+                q.enqueue_nowait(std::move(new_msg));
+            } else {
+                assert(overflow_policy == async_overflow_policy::discard_new);
+                q.enqueue_if_have_room(std::move(new_msg));
+            }
+        }, q_);
+    }
+
+    // records drained per wakeup
+    static constexpr size_t max_batch_size = 128;
+
+    // scratch space of one worker, reused across batches
+    struct worker_batch {
+        std::vector<async_msg> msgs;
+        std::vector<async_msg> flushes;
+        std::vector<log_msg> pending;
+        std::vector<memory_buf_t> rendered;
+        std::vector<char> records;
+    };
+
     void worker_loop_() {
-        while (process_next_msg_()) {
+        worker_batch batch;
+        batch.pending.reserve(max_batch_size);
+        batch.rendered.resize(max_batch_size);
+        while (process_next_batch_(batch)) {
 
         }
     }
 
-    bool process_next_msg_();
+    bool process_next_batch_(worker_batch& batch);
+
+    // a flush of this batch runs at once when every log record it waits for is released,
+    // otherwise it is parked for the worker that releases the last of them
+    void park_flushes_(worker_batch& batch);
+    // flushes the sinks of the parked flushes that are ready, outside the lock
+    void complete_parked_flushes_();
+    static void complete_flush_(async_msg& flush_msg);
+
+    // takes the backend of a destroyed async_logger, freed here when every record it posted
+    // is released already, otherwise by the worker that releases the last one
+    void retire_backend_(std::unique_ptr<details::async_backend> backend, size_t posted);
+    // frees the retired backends with nothing left in flight, outside the lock
+    void free_released_backends_();
+
+    // byte_ring: the record is written straight from msg, no async_msg is built.
+    // the record owns flush until it is dequeued or dropped
+    void post_record_(byte_ring_queue& q, details::async_backend *worker_ptr, async_msg_type msg_type,
+                      const log_msg& msg, async_overflow_policy overflow_policy,
+                      flush_request *flush = nullptr);
+    size_t dequeue_records_(byte_ring_queue& q, worker_batch& batch);
+    static void drop_record_(std::span<const char> record);
 };
 }
\ No newline at end of file
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <ctime>
+#include <string_view>
+
+#include <minilog/common.h>
+
+namespace minilog {
+
+// renders "YYYY-MM-DD HH:MM:SS.mmm ZONE", the calendar part is rebuilt only when the second changes
+class time_cache {
+public:
+    // length of "YYYY-MM-DD HH:MM:SS.mmm" without the zone suffix
+    static constexpr size_t datetime_length = 23;
+
+    std::string_view format(log_clock::time_point tp) {
+        auto secs = std::chrono::floor<std::chrono::seconds>(tp);
+        if (secs != cached_seconds_) {
+            rebuild_(secs);
+        }
+        auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(tp - secs).count();
+        buffer_[millis_offset_] = static_cast<char>('0' + millis / 100);
+        buffer_[millis_offset_ + 1] = static_cast<char>('0' + millis / 10 % 10);
+        buffer_[millis_offset_ + 2] = static_cast<char>('0' + millis % 10);
+        return {buffer_.data(), length_};
+    }
+
+private:
+    static constexpr size_t millis_offset_ = 20;
+
+    void rebuild_(std::chrono::sys_seconds secs) {
+        std::time_t t = log_clock::to_time_t(secs);
+        std::tm tm{};
+        localtime_r(&t, &tm);
+        length_ = std::strftime(buffer_.data(), buffer_.size(), "%Y-%m-%d %H:%M:%S.000 %Z", &tm);
+        cached_seconds_ = secs;
+    }
+
+    std::array<char, 64> buffer_{};
+    size_t length_{0};
+    std::chrono::sys_seconds cached_seconds_{std::chrono::sys_seconds::min()};
+};
+
+inline std::string_view format_time(log_clock::time_point tp) {
+    thread_local time_cache cache;
+    return cache.format(tp);
+}
+}
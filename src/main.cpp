@@ -10,12 +10,48 @@
 
 #include <minilog/minilog.h>
 #include <minilog/sinks/basic_file_sink.h>
+#include <minilog/sinks/binary_file_sink.h>
+#include <minilog/sinks/rotating_file_sink.h>
+#include <minilog/sinks/daily_file_sink.h>
+#include <minilog/sinks/mmap_file_sink.h>
 #include <minilog/sinks/stdout_color_sinks.h>
 #include <minilog/sinks/callback_sink.h>
+#include <minilog/sinks/dup_filter_sink.h>
 #include <minilog/cfg.h>
 #include <minilog/sinks/db_sink.h>
+#include <minilog/sinks/mysql_writer.h>
 #include <minilog/async_logger.h>
+#include <filesystem>
+#include <fstream>
+#include <future>
 #include <iostream>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <linux/magic.h>
+#include <sys/statfs.h>
+
+// counts every heap allocation made by the program, see minilog_allocation_count_example
+static std::atomic<size_t> allocation_count{0};
+
+void *operator new(std::size_t size) {
+    ++allocation_count;
+    if (void *ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
 
 // multi/single threaded loggers
 // console logging (colors supported)
@@ -127,16 +163,104 @@ void minilog_callback_example()
 
 void minilog_db_sink()
 {
-    auto callback_sink = std::make_shared<minilog::sinks::callback_sink_mt>(minilog::sinks::sink_to_db);
-    callback_sink->set_level(minilog::level::error);
+    auto pool = std::make_shared<minilog::sinks::db_connection_pool>(minilog::sinks::db_config::from_env());
+    auto db_sink = std::make_shared<minilog::sinks::db_sink_mt>(std::make_unique<minilog::sinks::mysql_writer>(pool));
+    db_sink->set_level(minilog::level::error);
     auto console_sink = std::make_shared<minilog::sinks::stdout_color_sink_mt>();
-    minilog::logger logger("custom_callback_logger", {console_sink, callback_sink});
+    minilog::logger logger("minilog_db_logger", {console_sink, db_sink});
 
     logger.info("some info log");
     logger.error("critical 'issue");
     logger.error("use double quotes \" double quotes");
     logger.error("use single quotes ' single quotes");
+    for (int i = 0; i < 10'000; ++i) {
+        logger.error("batched row #{}", i);
+    }
+    // waits until the rows are in the table
+    logger.flush();
+}
+
+// stands in for the database: counts the rows and batches it got, a batch holding a
+// "reject" row throws like a failed INSERT
+class counting_db_writer final : public minilog::sinks::db_writer {
+public:
+    struct counts {
+        std::atomic<size_t> rows{0};
+        std::atomic<size_t> batches{0};
+    };
+
+    explicit counting_db_writer(std::shared_ptr<counts> counts) : counts_(std::move(counts)) {}
+
+    void write(std::span<const minilog::sinks::db_row> rows) override {
+        for (const auto &row : rows) {
+            if (row.message == "reject") {
+                throw std::runtime_error("rejected by the stand-in writer");
+            }
+        }
+        counts_->rows += rows.size();
+        ++counts_->batches;
+    }
 
+private:
+    std::shared_ptr<counts> counts_;
+};
+
+// db_sink without a database: full batches go out on their own, a partial one after
+// flush_interval, flush() returns once every row is stored or failed. false when a
+// trigger doesn't fire or a row goes missing
+bool minilog_db_sink_writer_example() {
+    auto wait_for = [](auto done) {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (!done() && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return done();
+    };
+
+    bool rejected = false;
+    try {
+        minilog::sinks::db_sink_mt too_small(std::make_unique<counting_db_writer>(std::make_shared<counting_db_writer::counts>()),
+                                             {.batch_size = 100, .max_pending_rows = 50});
+    } catch (const std::runtime_error &) {
+        rejected = true;
+    }
+
+    // size trigger: 250 rows hold two full batches, the rest may wait for flush()
+    auto by_size = std::make_shared<counting_db_writer::counts>();
+    auto size_sink = std::make_shared<minilog::sinks::db_sink_mt>(std::make_unique<counting_db_writer>(by_size),
+                                                                  minilog::sinks::db_sink_options{.batch_size = 100, .flush_interval = std::chrono::seconds(60)});
+    minilog::logger size_logger("minilog_db_by_size", size_sink);
+    for (int i = 0; i < 250; ++i) {
+        size_logger.error("row #{}", i);
+    }
+    bool size_trigger = wait_for([&] { return by_size->rows >= 200; });
+    size_logger.flush();
+    bool flushed = by_size->rows == 250;
+
+    size_logger.error("reject");
+    size_logger.error("stored with the rejected row, lost with it");
+    size_logger.flush();
+    bool failures_counted = size_sink->failed_rows() == 2 && by_size->rows == 250;
+
+    // time trigger: 10 rows never fill a batch, they go out after 50 ms
+    auto by_time = std::make_shared<counting_db_writer::counts>();
+    auto time_sink = std::make_shared<minilog::sinks::db_sink_mt>(std::make_unique<counting_db_writer>(by_time),
+                                                                  minilog::sinks::db_sink_options{.batch_size = 1000, .flush_interval = std::chrono::milliseconds(50)});
+    minilog::logger time_logger("minilog_db_by_time", time_sink);
+    for (int i = 0; i < 10; ++i) {
+        time_logger.error("row #{}", i);
+    }
+    bool time_trigger = wait_for([&] { return by_time->rows == 10; });
+
+    if (!rejected || !size_trigger || !flushed || !failures_counted || !time_trigger) {
+        std::cerr << std::format("FAILED: max_pending_rows < batch_size rejected: {}, size trigger: {}, flush: {} rows in {} batches, "
+                                 "failed_rows: {}, time trigger: {}\n",
+                                 rejected, size_trigger, by_size->rows.load(), by_size->batches.load(),
+                                 size_sink->failed_rows(), time_trigger);
+        return false;
+    }
+    std::cout << "db_sink: size and time triggers fired, flush stored 250 rows, 2 failed rows counted\n";
+    return true;
 }
 
 void async_example() {
@@ -156,6 +280,8 @@ void minilog_async_example() {
     for (int i = 0; i < 101; ++i) {
         async_file->info("async message #{}", i);
     }
+    // the 101 messages are written and the file flushed once the future is ready
+    std::static_pointer_cast<minilog::async_logger>(async_file)->flush().get();
 }
 
 void multi_sink_example2()
@@ -188,6 +314,229 @@ void minilog_multi_sink_example2()
     logger->error("an error message");
 }
 
+// the caller only copies the arguments, std::vformat runs on the worker thread
+void minilog_deferred_async_example() {
+    auto async_file = minilog::basic_logger_mt<minilog::async_factory>("minilog_deferred_file_logger", "logs/minilog_deferred_log.txt");
+    std::static_pointer_cast<minilog::async_logger>(async_file)->set_deferred_formatting(true);
+
+    for (int i = 0; i < 101; ++i) {
+        async_file->info("deferred message #{} {:.2f} {}", i, i * 0.5, std::string("copied"));
+    }
+}
+
+// decode with: minilog-decode logs/minilog_binary.bin
+void minilog_binary_log_example() {
+    minilog::init_thread_pool(8192, 1);
+    auto binary_sink = std::make_shared<minilog::sinks::binary_file_sink_mt>("logs/minilog_binary.bin");
+    auto logger = std::make_shared<minilog::async_logger>("minilog_binary", binary_sink, minilog::thread_pool());
+    logger->set_deferred_formatting(true);
+
+    for (int i = 0; i < 101; ++i) {
+        logger->info("request #{} took {:.3f} ms", i, i * 0.25);
+    }
+}
+
+// records only carry a plain pointer to their logger's backend. dropping the last
+// reference while they are still queued returns at once, the worker writes them and
+// then lets go of the sinks. a logger dropped from its own sink, on the worker, doesn't
+// wait for itself. false when a message is lost or the sink is never released
+bool minilog_drop_async_logger_example() {
+    minilog::init_thread_pool(8192, 1);
+    std::atomic<int> written{0};
+    auto slow_sink = std::make_shared<minilog::sinks::callback_sink_mt>([&written](const minilog::log_msg&) {
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+        ++written;
+    });
+    auto logger = std::make_shared<minilog::async_logger>("minilog_dropped", slow_sink, minilog::thread_pool());
+    for (int i = 0; i < 1000; ++i) {
+        logger->info("in flight #{}", i);
+    }
+    auto start = std::chrono::steady_clock::now();
+    logger.reset();
+    std::chrono::duration<double, std::milli> drop_time = std::chrono::steady_clock::now() - start;
+    int written_at_drop = written.load();
+
+    // the last reference is handed to the sink and goes away there, on the pool worker
+    std::promise<std::shared_ptr<minilog::logger>> handover;
+    std::atomic<bool> self_dropped{false};
+    auto dropping_sink = std::make_shared<minilog::sinks::callback_sink_mt>([&](const minilog::log_msg&) {
+        handover.get_future().get().reset();
+        self_dropped = true;
+    });
+    {
+        auto self_dropping = std::make_shared<minilog::async_logger>("minilog_self_dropped", dropping_sink, minilog::thread_pool());
+        self_dropping->info("drops its own logger");
+        handover.set_value(std::move(self_dropping));
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while ((written.load() != 1000 || slow_sink.use_count() != 1 || !self_dropped) && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    if (written.load() != 1000 || slow_sink.use_count() != 1 || !self_dropped) {
+        std::cerr << std::format("FAILED: {} of 1000 messages written, sink still held: {}, dropped on the worker: {}\n",
+                                 written.load(), slow_sink.use_count() != 1, self_dropped.load());
+        return false;
+    }
+    std::cout << std::format("drop returned in {:.2f} ms with {} / 1000 written, all 1000 written after\n",
+                             drop_time.count(), written_at_drop);
+    return true;
+}
+
+// 5 MiB per file, logs/minilog_rotating.txt plus 3 rotated ones
+void minilog_rotating_example() {
+    auto rotating_logger = minilog::rotating_logger_mt("minilog_rotating", "logs/minilog_rotating.txt", 5 * 1024 * 1024, 3);
+    for (int i = 0; i < 200'000; ++i) {
+        rotating_logger->info("rotating message #{}", i);
+    }
+}
+
+// new file at 02:30 every day, 30 files kept, closed ones gzipped in the background
+void minilog_daily_example() {
+    auto daily_logger = minilog::daily_logger_mt("minilog_daily", "logs/minilog_daily.txt", 2, 30, false, 30, true);
+    daily_logger->info("daily message");
+    auto hourly_logger = minilog::hourly_logger_mt("minilog_hourly", "logs/minilog_hourly.txt", false, 24 * 7, true);
+    hourly_logger->info("hourly message");
+}
+
+// lines are copied into a mapping of the file, flush() runs msync
+void minilog_mmap_example() {
+    auto mmap_sink = std::make_shared<minilog::sinks::mmap_file_sink_mt>("logs/minilog_mmap.txt");
+    minilog::logger mmap_logger("minilog_mmap", mmap_sink);
+    for (int i = 0; i < 100'000; ++i) {
+        mmap_logger.info("mmap message #{}", i);
+    }
+    mmap_logger.flush();
+}
+
+// resolves "minilog_component" once per registry change instead of once per request
+void minilog_logger_handle_example() {
+    minilog::stdout_color_mt("minilog_component");
+    static minilog::logger_handle component_log("minilog_component");
+    for (int request = 0; request < 3; ++request) {
+        component_log->info("handling request #{}", request);
+        minilog::get("minilog_component")->info("same logger through the per thread cache");
+    }
+    minilog::registry::get_instance().drop_logger("minilog_component");
+}
+
+// repeats of the same line within 5 seconds reach the console once, followed by
+// "message repeated 999 times" when a different message comes in
+void minilog_dup_filter_example() {
+    auto console_sink = std::make_shared<minilog::sinks::ansicolor_stdout_sink_mt>();
+    auto dup_filter = std::make_shared<minilog::sinks::dup_filter_sink_mt>(
+        std::chrono::seconds(5), std::vector<std::shared_ptr<minilog::sinks::sink>>{console_sink});
+    minilog::logger logger("minilog_dup_filter", {dup_filter});
+    for (int i = 0; i < 1000; ++i) {
+        logger.warn("queue {} is full", "ingest");
+    }
+    logger.info("queue {} drained", "ingest");
+}
+
+// a failing dependency logs from one line in a tight loop, 10 lines per second get
+// through and the next window starts with how many were dropped
+void minilog_rate_limit_example() {
+    auto console = minilog::stdout_color_mt("minilog_rate_limit");
+    console->set_rate_limit(10, std::chrono::seconds(1));
+    auto start = std::chrono::steady_clock::now();
+    while (std::chrono::steady_clock::now() - start < std::chrono::milliseconds(2500)) {
+        console->error("dependency unreachable: {}", "connection refused");
+    }
+    console->set_rate_limit(0, {});
+    console->set_sampling(1000);
+    for (int i = 0; i < 10'000; ++i) {
+        console->info("sampled request #{}", i);
+    }
+}
+
+// runs at info, the last 32 debug messages are written ahead of the error
+void minilog_backtrace_example() {
+    auto console = minilog::stdout_color_mt("minilog_backtrace");
+    console->enable_backtrace(32);
+    for (int i = 0; i < 100; ++i) {
+        console->debug("backtrace message #{}", i);
+    }
+    console->error("something failed, the debug context comes first");
+}
+
+// nothing is flushed per message, the registry flushes every logger every 2 seconds.
+// the async logger gets a flush record posted behind its messages instead
+void minilog_flush_every_example() {
+    minilog::flush_every(std::chrono::seconds(2));
+    auto file_logger = minilog::basic_logger_mt("minilog_flush_every", "logs/minilog_flush_every.txt");
+    auto async_file_logger = minilog::basic_logger_mt<minilog::async_factory>("minilog_flush_every_async", "logs/minilog_flush_every_async.txt");
+    file_logger->flush_on(minilog::level::error);
+    for (int i = 0; i < 5; ++i) {
+        file_logger->info("flushed within 2 seconds #{}", i);
+        async_file_logger->info("written and flushed by the pool within 2 seconds #{}", i);
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+    }
+    file_logger->error("flushed right away");
+    minilog::registry::get_instance().stop_flush_every();
+    minilog::registry::get_instance().drop_logger("minilog_flush_every");
+    minilog::registry::get_instance().drop_logger("minilog_flush_every_async");
+}
+
+// the filesystem a directory is on, as the labels of minilog_file_backend_bench
+std::string filesystem_name(const std::string &dir) {
+    struct statfs fs{};
+    if (::statfs(dir.c_str(), &fs) != 0) {
+        return "unknown";
+    }
+    switch (static_cast<unsigned long>(fs.f_type)) {
+    case TMPFS_MAGIC: return "tmpfs";
+    case EXT4_SUPER_MAGIC: return "ext4";
+    case XFS_SUPER_MAGIC: return "xfs";
+    case BTRFS_SUPER_MAGIC: return "btrfs";
+    case OVERLAYFS_SUPER_MAGIC: return "overlayfs";
+    default: return std::format("{:#x}", static_cast<unsigned long>(fs.f_type));
+    }
+}
+
+// the same formatted lines through std::ofstream (what file_helper used to be) and the
+// write(2) and io_uring backends of file_helper, on /dev/shm and under logs/. each line
+// names the filesystem the directory is really on. the output files are removed after
+void minilog_file_backend_bench() {
+    constexpr int lines = 2'000'000;
+    minilog::pattern_formatter formatter;
+    std::string name = "file_bench";
+    minilog::log_msg msg(name, minilog::level::info, "a file backend benchmark message with some payload", std::source_location::current());
+    minilog::memory_buf_t line;
+    formatter.format(msg, line);
+
+    auto bench = [&](const std::string &label, auto &&write_all) {
+        auto start = std::chrono::steady_clock::now();
+        write_all();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        double mib = static_cast<double>(line.size()) * lines / (1024 * 1024);
+        std::cout << std::format("{:<32} {:8.1f} ms {:8.1f} MiB/s\n", label, elapsed.count() * 1000, mib / elapsed.count());
+    };
+
+    for (std::string dir : {"/dev/shm", "logs"}) {
+        std::filesystem::create_directories(dir);
+        std::string fs_label = std::format("{} ({})", dir, filesystem_name(dir));
+        bench(fs_label + " ofstream", [&] {
+            std::ofstream out(dir + "/minilog_bench_ofstream.txt");
+            for (int i = 0; i < lines; ++i) {
+                out.write(line.data(), static_cast<std::streamsize>(line.size()));
+            }
+        });
+        for (auto backend : {minilog::file_io_backend::write, minilog::file_io_backend::io_uring}) {
+            std::string label = std::format("{} {}", fs_label, magic_enum::enum_name(backend));
+            bench(label, [&] {
+                minilog::file_helper file(std::format("{}/minilog_bench_{}.txt", dir, magic_enum::enum_name(backend)), true, {backend});
+                for (int i = 0; i < lines; ++i) {
+                    file.write(line);
+                }
+                file.flush();
+            });
+        }
+        for (std::string_view backend : {"ofstream", "write", "io_uring"}) {
+            std::filesystem::remove(std::format("{}/minilog_bench_{}.txt", dir, backend));
+        }
+    }
+}
+
 void replace_default_logger_example() {
     auto new_logger = spdlog::basic_logger_mt("new_default_logger", "logs/new-default-log.txt", true);
     spdlog::set_default_logger(new_logger);
@@ -239,6 +588,128 @@ void minilog_registry_base() {
     minilog::trace("the message should be printed when env var MINILOG_LEVEL = trace");
 }
 
+// MINILOG_LEVEL="info,net=debug,net.packets=debug": the net logger at debug, the db logger at
+// info and the packet dump on, whatever logs it. without the switch entry the dump is never formatted
+void minilog_level_spec_example() {
+    static minilog::log_switch packets("net.packets");
+    auto net = minilog::stdout_color_mt("net");
+    auto db = minilog::stdout_color_mt("db");
+    minilog::cfg::load_env_levels();
+    net->debug("connected to {}:{}", "10.0.0.7", 5432);
+    db->debug("not shown while db is at info");
+    db->log(packets, minilog::level::debug, "query packet {:02x}", 0x51);
+    minilog::cfg::load_levels("db=debug");
+    db->debug("changed at runtime");
+}
+
+void minilog_pattern_example() {
+    auto console = minilog::stdout_color_mt("minilog_pattern_console");
+    console->info("default pattern");
+    console->set_pattern("%^[%H:%M:%S.%e] [%L]%$ %v");
+    console->info("short pattern, only the prefix is colored");
+
+    auto file_sink = std::make_shared<minilog::sinks::basic_file_sink_mt>("logs/minilog_pattern.txt");
+    file_sink->set_pattern("%Y-%m-%d %H:%M:%S.%e [%l] [%n] %s:%# %v");
+    minilog::logger logger("pattern_file", file_sink);
+    logger.warn("per sink pattern");
+}
+
+// many producers hammering the async queue: mutex based queue, lock free ring, per thread rings
+void minilog_async_queue_bench() {
+    constexpr int producers = 32;
+    constexpr int messages_per_producer = 20'000;
+    for (auto queue_kind : {minilog::async_queue_kind::blocking, minilog::async_queue_kind::lock_free,
+                            minilog::async_queue_kind::per_thread, minilog::async_queue_kind::byte_ring}) {
+        // the byte ring is sized in bytes, 1 MiB holds about as many of these records
+        size_t q_size = queue_kind == minilog::async_queue_kind::byte_ring ? 1 << 20 : 8192;
+        auto tp = std::make_shared<class minilog::thread_pool>(q_size, 1, queue_kind);
+        auto null_sink = std::make_shared<minilog::sinks::callback_sink_mt>([](const minilog::log_msg&) {});
+        auto logger = std::make_shared<minilog::async_logger>("queue_bench", null_sink, tp);
+
+        auto start = std::chrono::steady_clock::now();
+        {
+            std::vector<std::jthread> threads;
+            for (int t = 0; t < producers; ++t) {
+                threads.emplace_back([&logger] {
+                    for (int i = 0; i < messages_per_producer; ++i) {
+                        logger->info("message #{}", i);
+                    }
+                });
+            }
+        }
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << std::format("{}: {:.1f} ns per enqueue\n", magic_enum::enum_name(queue_kind),
+                                 elapsed.count() / (producers * messages_per_producer));
+    }
+}
+
+// once warmed up, a synchronous logger formats into inline buffers and allocates nothing.
+// false when any of the 1000 messages allocated
+bool minilog_allocation_count_example() {
+    auto file_sink = std::make_shared<minilog::sinks::basic_file_sink_st>("logs/minilog_alloc.txt");
+    minilog::logger logger("allocation_count", file_sink);
+    logger.info("warm up #{}", 0);
+
+    size_t before = allocation_count.load();
+    for (int i = 0; i < 1000; ++i) {
+        logger.info("steady state message #{} {:.3f} {}", i, i * 0.5, "text");
+    }
+    size_t allocations = allocation_count.load() - before;
+    if (allocations != 0) {
+        std::cerr << std::format("FAILED: {} heap allocations for 1000 messages, expected 0\n", allocations);
+        return false;
+    }
+    std::cout << "heap allocations for 1000 messages: 0\n";
+    return true;
+}
+
+// a filtered out call should cost about as much as the relaxed atomic load of the level
+void minilog_disabled_level_bench() {
+    constexpr int iterations = 10'000'000;
+    auto null_sink = std::make_shared<minilog::sinks::callback_sink_st>([](const minilog::log_msg&) {});
+    minilog::logger logger("disabled_bench", null_sink);
+    logger.set_level(minilog::level::info);
+
+    std::atomic<int> level{minilog::level::info};
+    volatile int blackhole = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        blackhole = level.load(std::memory_order_relaxed);
+    }
+    std::chrono::duration<double, std::nano> atomic_load = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        logger.debug("disabled message #{} {}", i, 3.14);
+    }
+    std::chrono::duration<double, std::nano> disabled_call = std::chrono::steady_clock::now() - start;
+
+    std::cout << std::format("atomic load: {:.2f} ns/op, disabled debug: {:.2f} ns/op\n",
+                             atomic_load.count() / iterations, disabled_call.count() / iterations);
+}
+
+// minilog::debug through the default logger from several threads. each call writes only
+// its own thread's hazard slot, the pointer and level are shared read-only. the publish
+// comes before the level compare, about 5 ns per call against 2 ns through the raw pointer
+void minilog_disabled_default_logger_bench() {
+    constexpr int iterations = 10'000'000;
+    minilog::set_level(minilog::level::info);
+    for (unsigned threads : {1u, 4u, std::max(1u, std::thread::hardware_concurrency())}) {
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::jthread> workers;
+        for (unsigned t = 0; t < threads; ++t) {
+            workers.emplace_back([] {
+                for (int i = 0; i < iterations; ++i) {
+                    minilog::debug("disabled message #{} {}", i, 3.14);
+                }
+            });
+        }
+        workers.clear();
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << std::format("{} threads: {:.2f} ns per disabled minilog::debug\n", threads, elapsed.count() / iterations);
+    }
+}
+
 int main(int argc, char *argv[]) {
     // stdout_example();
     // minilog_stdout_example();
@@ -262,7 +733,30 @@ int main(int argc, char *argv[]) {
 
     // async_example();
     // minilog_async_example();
+    // minilog_deferred_async_example();
+    // minilog_binary_log_example();
+    // minilog_rotating_example();
+    // minilog_daily_example();
+    // minilog_mmap_example();
+    // minilog_flush_every_example();
+    // minilog_backtrace_example();
+    // minilog_rate_limit_example();
+    // minilog_dup_filter_example();
+    // minilog_level_spec_example();
+    // minilog_logger_handle_example();
+    // minilog_file_backend_bench();
 
     multi_sink_example2();
     minilog_multi_sink_example2();
+
+    // minilog_pattern_example();
+    // minilog_disabled_level_bench();
+    // minilog_disabled_default_logger_bench();
+    // minilog_async_queue_bench();
+
+    bool passed = true;
+    passed = minilog_allocation_count_example() && passed;
+    passed = minilog_drop_async_logger_example() && passed;
+    passed = minilog_db_sink_writer_example() && passed;
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
 }
\ No newline at end of file
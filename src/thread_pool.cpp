@@ -1,22 +1,304 @@
 #include <minilog/thread_pool.h>
 #include <minilog/async_logger.h>
 
-bool minilog::thread_pool::process_next_msg_() {
-    async_msg incoming_async_msg;
-    q_.dequeue(incoming_async_msg);
-
-    if (incoming_async_msg.msg_type == async_msg_type::log) {
-        incoming_async_msg.worker_ptr->backend_sink_it_(incoming_async_msg);
-        return true;
-    } else if (incoming_async_msg.msg_type == async_msg_type::flush) {
-        incoming_async_msg.worker_ptr->backend_flush_();
-        return true;
-    } else if (incoming_async_msg.msg_type == async_msg_type::terminate) {
-        return false;
+#include <cstring>
+
+namespace {
+// fixed part of a byte_ring record, followed by the logger name, the payload,
+// the encoded arguments and the format string unless it is a literal
+struct record_header {
+    minilog::async_msg_type msg_type;
+    minilog::details::async_backend *worker_ptr;
+    minilog::flush_request *flush;
+    minilog::level::level_enum level;
+    minilog::log_clock::time_point time;
+    std::source_location location;
+    minilog::deferred_format_fn format_fn;
+    const char *static_format;
+    uint32_t name_size;
+    uint32_t payload_size;
+    uint32_t args_size;
+    uint32_t format_size;
+};
+static_assert(std::is_trivially_copyable_v<record_header>);
+
+// cut at most max bytes without splitting a utf-8 sequence
+std::string_view truncate_utf8(std::string_view text, size_t max) {
+    if (text.size() <= max) {
+        return text;
+    }
+    while (max > 0 && (static_cast<unsigned char>(text[max]) & 0xC0) == 0x80) {
+        --max;
+    }
+    return text.substr(0, max);
+}
+}
+
+void minilog::async_msg::release() noexcept {
+    flush.reset();
+    if (worker_ptr != nullptr) {
+        std::exchange(worker_ptr, nullptr)->record_done(msg_type);
+    }
+}
+
+void minilog::thread_pool::post_record_(byte_ring_queue& q, details::async_backend *worker_ptr, async_msg_type msg_type,
+                                       const log_msg& msg, async_overflow_policy overflow_policy,
+                                       flush_request *flush) {
+    std::string_view name = msg.logger_name;
+    std::string_view payload = msg.payload;
+    std::string_view args = msg.format_args;
+    std::string_view format = msg.static_format_string ? std::string_view{} : msg.format_string;
+    deferred_format_fn format_fn = msg.format_fn;
+
+    size_t budget = q.max_record_size() - sizeof(record_header);
+    name = truncate_utf8(name, budget / 4);
+    budget -= name.size();
+
+    // too big for the ring: render it here and keep what fits of the text
+    memory_buf_t rendered;
+    if (payload.size() + args.size() + format.size() > budget) {
+        if (format_fn) {
+            format_fn(msg.format_string, msg.format_args, rendered);
+            payload = rendered.view();
+            format_fn = nullptr;
+            args = {};
+            format = {};
+        }
+        if (payload.size() > budget) {
+            payload = truncate_utf8(payload, budget);
+            truncate_counter_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    const bool static_format = format_fn != nullptr && msg.static_format_string;
+    record_header header{
+        msg_type,
+        worker_ptr,
+        flush,
+        msg.level,
+        msg.time,
+        msg.location,
+        format_fn,
+        static_format ? msg.format_string.data() : nullptr,
+        static_cast<uint32_t>(name.size()),
+        static_cast<uint32_t>(payload.size()),
+        static_cast<uint32_t>(args.size()),
+        static_cast<uint32_t>(static_format ? msg.format_string.size() : format.size())};
+
+    const size_t size = sizeof(header) + name.size() + payload.size() + args.size() + format.size();
+    auto fill = [&](char *dest) {
+        std::memcpy(dest, &header, sizeof(header));
+        dest += sizeof(header);
+        for (std::string_view part : {name, payload, args, format}) {
+            if (!part.empty()) {
+                std::memcpy(dest, part.data(), part.size());
+                dest += part.size();
+            }
+        }
+    };
+
+    bool queued = true;
+    if (overflow_policy == async_overflow_policy::block) {
+        q.enqueue(size, fill);
+    } else if (overflow_policy == async_overflow_policy::overrun_oldest) {
+        q.enqueue_nowait(size, fill);
     } else {
-        assert(false);
+        assert(overflow_policy == async_overflow_policy::discard_new);
+        queued = q.enqueue_if_have_room(size, fill);
+    }
+    if (!queued) {
+        delete flush;
+        if (worker_ptr != nullptr) {
+            worker_ptr->record_done(msg_type);
+        }
+    }
+}
+
+// views into batch.records, which stays untouched until the next batch
+size_t minilog::thread_pool::dequeue_records_(byte_ring_queue& q, worker_batch& batch) {
+    if (batch.msgs.size() < max_batch_size) {
+        batch.msgs.resize(max_batch_size);
+    }
+    size_t count = q.dequeue_bulk(batch.records, max_batch_size);
+
+    size_t i = 0;
+    byte_ring_queue::for_each_record(batch.records, [&](std::span<const char> record) {
+        record_header header;
+        std::memcpy(&header, record.data(), sizeof(header));
+        const char *cursor = record.data() + sizeof(header);
+
+        async_msg &msg = batch.msgs[i++];
+        msg.msg_type = header.msg_type;
+        msg.worker_ptr = header.worker_ptr;
+        msg.flush.reset(header.flush);
+        msg.level = header.level;
+        msg.time = header.time;
+        msg.location = header.location;
+        msg.format_fn = header.format_fn;
+        msg.logger_name = std::string_view{cursor, header.name_size};
+        cursor += header.name_size;
+        msg.payload = std::string_view{cursor, header.payload_size};
+        cursor += header.payload_size;
+        msg.format_args = std::string_view{cursor, header.args_size};
+        cursor += header.args_size;
+        msg.static_format_string = header.static_format != nullptr;
+        msg.format_string = std::string_view{msg.static_format_string ? header.static_format : cursor, header.format_size};
+    });
+    return count;
+}
+
+void minilog::thread_pool::drop_record_(std::span<const char> record) {
+    record_header header;
+    std::memcpy(&header, record.data(), sizeof(header));
+    delete header.flush;
+    if (header.worker_ptr != nullptr) {
+        header.worker_ptr->record_done(header.msg_type);
+    }
+}
+
+bool minilog::thread_pool::process_next_batch_(worker_batch& batch) {
+    size_t count = std::visit([&](auto &q) {
+        if constexpr (std::is_same_v<std::decay_t<decltype(q)>, byte_ring_queue>) {
+            return dequeue_records_(q, batch);
+        } else {
+            return q.dequeue_bulk(batch.msgs, max_batch_size);
+        }
+    }, q_);
+
+    // consecutive records of the same logger go to its sinks as one batch
+    details::async_backend *pending_logger = nullptr;
+    auto sink_pending = [&] {
+        if (!batch.pending.empty()) {
+            pending_logger->sink_batch(batch.pending);
+            batch.pending.clear();
+        }
+    };
+
+    size_t terminate_count = 0;
+    for (size_t i = 0; i < count; ++i) {
+        async_msg &incoming_async_msg = batch.msgs[i];
+        if (incoming_async_msg.msg_type == async_msg_type::log) {
+            if (incoming_async_msg.worker_ptr != pending_logger) {
+                sink_pending();
+                pending_logger = incoming_async_msg.worker_ptr;
+            }
+            // a message formatted by the caller may carry its arguments too, for the sinks that want them
+            if (incoming_async_msg.format_fn && incoming_async_msg.payload.empty()) {
+                memory_buf_t &formatted = batch.rendered[i];
+                formatted.clear();
+                incoming_async_msg.format_fn(incoming_async_msg.format_string, incoming_async_msg.format_args, formatted);
+                log_msg rendered_msg(incoming_async_msg);
+                rendered_msg.payload = formatted.view();
+                batch.pending.push_back(rendered_msg);
+            } else {
+                batch.pending.push_back(incoming_async_msg);
+            }
+        } else if (incoming_async_msg.msg_type == async_msg_type::flush) {
+            sink_pending();
+            // the log records before it in this batch are only released below
+            batch.flushes.push_back(std::move(incoming_async_msg));
+        } else if (incoming_async_msg.msg_type == async_msg_type::terminate) {
+            ++terminate_count;
+        } else {
+            assert(false);
+        }
+    }
+    sink_pending();
+
+    for (size_t i = 0; i < count; ++i) {
+        batch.msgs[i].release();
+    }
+    if (!batch.flushes.empty()) {
+        park_flushes_(batch);
+    }
+    if (has_parked_flushes_.load(std::memory_order_seq_cst)) {
+        complete_parked_flushes_();
+    }
+    if (has_retired_.load(std::memory_order_seq_cst)) {
+        free_released_backends_();
+    }
+    // each worker exits on one terminate, hand the others back to the remaining workers
+    for (size_t i = 1; i < terminate_count; ++i) {
+        post_async_msg_(async_msg(async_msg_type::terminate), async_overflow_policy::block);
+    }
+    return terminate_count == 0;
+}
+
+void minilog::thread_pool::retire_backend_(std::unique_ptr<details::async_backend> backend, size_t posted) {
+    if (backend->released() == posted) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(retired_mutex_);
+        retired_.emplace_back(std::move(backend), posted);
+        // set before checking the counts again, a worker releasing the last record after
+        // that check sees the flag
+        has_retired_.store(true, std::memory_order_seq_cst);
+    }
+    free_released_backends_();
+}
+
+void minilog::thread_pool::free_released_backends_() {
+    std::vector<std::shared_ptr<details::async_backend>> released;
+    {
+        std::lock_guard<std::mutex> lock(retired_mutex_);
+        std::erase_if(retired_, [&released](auto &retired) {
+            if (retired.first->released() != retired.second) {
+                return false;
+            }
+            released.push_back(std::move(retired.first));
+            return true;
+        });
+        has_retired_.store(!retired_.empty(), std::memory_order_seq_cst);
     }
-    return true;
 }
 
+void minilog::thread_pool::park_flushes_(worker_batch& batch) {
+    bool parked = false;
+    for (auto &flush_msg : batch.flushes) {
+        if (flush_msg.worker_ptr->logs_released() >= flush_msg.flush->logs_posted) {
+            complete_flush_(flush_msg);
+            continue;
+        }
+        std::lock_guard<std::mutex> lock(parked_flushes_mutex_);
+        parked_flushes_.push_back(std::move(flush_msg));
+        // set before the counts are checked again, a worker releasing the last record
+        // after that check sees the flag
+        has_parked_flushes_.store(true, std::memory_order_seq_cst);
+        parked = true;
+    }
+    batch.flushes.clear();
+    if (parked) {
+        complete_parked_flushes_();
+    }
+}
 
+void minilog::thread_pool::complete_parked_flushes_() {
+    std::vector<async_msg> ready;
+    {
+        std::lock_guard<std::mutex> lock(parked_flushes_mutex_);
+        std::erase_if(parked_flushes_, [&ready](async_msg &flush_msg) {
+            if (flush_msg.worker_ptr->logs_released() < flush_msg.flush->logs_posted) {
+                return false;
+            }
+            ready.push_back(std::move(flush_msg));
+            return true;
+        });
+        has_parked_flushes_.store(!parked_flushes_.empty(), std::memory_order_seq_cst);
+    }
+    for (auto &flush_msg : ready) {
+        complete_flush_(flush_msg);
+    }
+}
+
+// releases the record, its backend may be freed once this returns
+void minilog::thread_pool::complete_flush_(async_msg& flush_msg) {
+    // a failing sink flush is reported through the future instead of ending the worker
+    try {
+        flush_msg.worker_ptr->flush();
+        flush_msg.flush->done.set_value();
+    } catch (...) {
+        flush_msg.flush->done.set_exception(std::current_exception());
+    }
+    flush_msg.release();
+}
@@ -0,0 +1,120 @@
+// turns a file written by binary_file_sink back into the default text layout
+//   minilog-decode <binary log> [output file]
+
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <magic_enum.hpp>
+
+#include <minilog/binary_format.h>
+#include <minilog/common.h>
+#include <minilog/time_cache.h>
+
+namespace {
+
+struct site {
+    minilog::level::level_enum level;
+    uint64_t line;
+    std::string_view file;
+    std::string_view logger_name;
+    std::string_view format;
+};
+
+std::string_view filename_of(std::string_view path) {
+    auto slash = path.find_last_of('/');
+    return slash == std::string_view::npos ? path : path.substr(slash + 1);
+}
+
+bool decode(std::string_view data, std::ostream &out) {
+    using namespace minilog;
+    binary::reader in(data);
+    std::string_view header;
+    int64_t time_ns;
+    if (!in.read_bytes(binary::magic.size(), header) || header != binary::magic || !in.read_raw(time_ns)) {
+        std::cerr << "minilog-decode: not a minilog binary log" << std::endl;
+        return false;
+    }
+
+    std::unordered_map<uint64_t, site> sites;
+    std::vector<binary::decoded_arg> args;
+    memory_buf_t payload;
+    memory_buf_t line;
+    time_cache times;
+    while (!in.at_end()) {
+        uint8_t kind;
+        in.read_byte(kind);
+        if (kind == static_cast<uint8_t>(binary::record_kind::site)) {
+            uint64_t id;
+            uint8_t level;
+            site new_site;
+            if (!in.read_varint(id) || !in.read_byte(level) || !in.read_varint(new_site.line) ||
+                !in.read_string(new_site.file) || !in.read_string(new_site.logger_name) || !in.read_string(new_site.format)) {
+                std::cerr << "minilog-decode: truncated site record" << std::endl;
+                return false;
+            }
+            new_site.level = static_cast<level::level_enum>(level);
+            sites[id] = new_site;
+        } else if (kind == static_cast<uint8_t>(binary::record_kind::log)) {
+            uint64_t id, delta, args_size;
+            std::string_view encoded;
+            if (!in.read_varint(id) || !in.read_varint(delta) || !in.read_varint(args_size) || !in.read_bytes(args_size, encoded)) {
+                std::cerr << "minilog-decode: truncated log record" << std::endl;
+                return false;
+            }
+            auto found = sites.find(id);
+            if (found == sites.end()) {
+                std::cerr << "minilog-decode: unknown call site " << id << std::endl;
+                return false;
+            }
+            const site &record_site = found->second;
+            time_ns += binary::unzigzag(delta);
+
+            payload.clear();
+            if (binary::decode_args(encoded, args)) {
+                binary::format_decoded(record_site.format, args, payload);
+            } else {
+                payload.append(record_site.format);
+            }
+
+            log_clock::time_point time{std::chrono::duration_cast<log_clock::duration>(std::chrono::nanoseconds(time_ns))};
+            line.clear();
+            std::format_to(std::back_inserter(line), "{}:{} [{}] [{}] [{}] {}\n",
+                           filename_of(record_site.file), record_site.line, times.format(time),
+                           record_site.logger_name, magic_enum::enum_name(record_site.level), payload.view());
+            out.write(line.data(), static_cast<std::streamsize>(line.size()));
+        } else {
+            std::cerr << "minilog-decode: unknown record kind " << static_cast<int>(kind) << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2 || argc > 3) {
+        std::cerr << "usage: minilog-decode <binary log> [output file]" << std::endl;
+        return 2;
+    }
+    std::ifstream input(argv[1], std::ios::binary);
+    if (!input) {
+        std::cerr << "minilog-decode: cannot open " << argv[1] << std::endl;
+        return 1;
+    }
+    std::ostringstream contents;
+    contents << input.rdbuf();
+    std::string data = std::move(contents).str();
+
+    if (argc == 3) {
+        std::ofstream output(argv[2]);
+        return decode(data, output) ? 0 : 1;
+    }
+    return decode(data, std::cout) ? 0 : 1;
+}